@@ -0,0 +1,129 @@
+//
+//  DomeGeometry.cpp
+//  RTI-Dome X2 plugin
+//
+//  Computes the dome azimuth the slit needs to be at for an off-centre German equatorial mount.
+//
+
+#include "DomeGeometry.h"
+
+#define DEG_TO_RAD  (M_PI/180.0)
+#define RAD_TO_DEG  (180.0/M_PI)
+
+CDomeGeometry::CDomeGeometry()
+{
+    m_dLatitude = 0;
+    m_dDomeRadius = 0;
+    m_dMountEast = 0;
+    m_dMountNorth = 0;
+    m_dMountUp = 0;
+    m_dGemArm = 0;
+    m_dFlipHA = 0;
+}
+
+void CDomeGeometry::setGeometry(double dLatitude, double dDomeRadius, double dMountEast, double dMountNorth, double dMountUp, double dGemArm)
+{
+    m_dLatitude = dLatitude * DEG_TO_RAD;
+    m_dDomeRadius = dDomeRadius;
+    m_dMountEast = dMountEast;
+    m_dMountNorth = dMountNorth;
+    m_dMountUp = dMountUp;
+    m_dGemArm = dGemArm;
+}
+
+void CDomeGeometry::azAltToHaDec(double dAz, double dAlt, double &dHA, double &dDec)
+{
+    double dSinDec;
+
+    dAz *= DEG_TO_RAD;
+    dAlt *= DEG_TO_RAD;
+
+    dSinDec = sin(m_dLatitude) * sin(dAlt) + cos(m_dLatitude) * cos(dAlt) * cos(dAz);
+    if(dSinDec > 1)
+        dSinDec = 1;
+    if(dSinDec < -1)
+        dSinDec = -1;
+    dDec = asin(dSinDec) * RAD_TO_DEG;
+    dHA = atan2(-sin(dAz) * cos(dAlt), sin(dAlt) * cos(m_dLatitude) - cos(dAlt) * cos(dAz) * sin(m_dLatitude)) * RAD_TO_DEG / 15.0;
+}
+
+int CDomeGeometry::getPierSide(double dHA)
+{
+    // before the flip the telescope is pointing East from the West side of the pier
+    return dHA < m_dFlipHA ? PIER_WEST : PIER_EAST;
+}
+
+double CDomeGeometry::getDomeAz(double dTelAz, double dTelAlt)
+{
+    double dHA;
+    double dDec;
+
+    if(!isEnabled())
+        return dTelAz;
+
+    azAltToHaDec(dTelAz, dTelAlt, dHA, dDec);
+    return getDomeAz(dTelAz, dTelAlt, getPierSide(dHA));
+}
+
+double CDomeGeometry::getDomeAz(double dTelAz, double dTelAlt, int nPierSide)
+{
+    double dPointing[3];
+    double dPolar[3];
+    double dDecAxis[3];
+    double dOrigin[3];
+    double dNorm;
+    double dSide;
+    double dB;
+    double dC;
+    double dT;
+    double dDomeAz;
+    int i;
+
+    if(!isEnabled())
+        return dTelAz;
+
+    dTelAz *= DEG_TO_RAD;
+    dTelAlt *= DEG_TO_RAD;
+
+    dPointing[0] = cos(dTelAlt) * sin(dTelAz);
+    dPointing[1] = cos(dTelAlt) * cos(dTelAz);
+    dPointing[2] = sin(dTelAlt);
+
+    dPolar[0] = 0;
+    dPolar[1] = cos(m_dLatitude);
+    dPolar[2] = sin(m_dLatitude);
+
+    // the Dec axis is perpendicular to the polar axis and to the optical axis
+    dDecAxis[0] = dPolar[1] * dPointing[2] - dPolar[2] * dPointing[1];
+    dDecAxis[1] = dPolar[2] * dPointing[0] - dPolar[0] * dPointing[2];
+    dDecAxis[2] = dPolar[0] * dPointing[1] - dPolar[1] * dPointing[0];
+    dNorm = sqrt(dDecAxis[0]*dDecAxis[0] + dDecAxis[1]*dDecAxis[1] + dDecAxis[2]*dDecAxis[2]);
+    if(dNorm < 1e-9) {
+        // pointing at the pole, the telescope can be anywhere around the RA axis, use the East-West axis.
+        dDecAxis[0] = 1;
+        dDecAxis[1] = 0;
+        dDecAxis[2] = 0;
+        dNorm = 1;
+    }
+    dSide = (nPierSide == PIER_WEST) ? -1 : 1;
+
+    dOrigin[0] = m_dMountEast;
+    dOrigin[1] = m_dMountNorth;
+    dOrigin[2] = m_dMountUp;
+    for(i = 0; i < 3; i++)
+        dOrigin[i] += dSide * m_dGemArm * dDecAxis[i] / dNorm;
+
+    // intersection of the optical axis with the dome : |origin + t*pointing| = radius
+    dB = dOrigin[0]*dPointing[0] + dOrigin[1]*dPointing[1] + dOrigin[2]*dPointing[2];
+    dC = dOrigin[0]*dOrigin[0] + dOrigin[1]*dOrigin[1] + dOrigin[2]*dOrigin[2] - m_dDomeRadius*m_dDomeRadius;
+    if(dB*dB - dC < 0)
+        return dTelAz * RAD_TO_DEG; // the telescope is outside the dome, the geometry is wrong.
+    dT = -dB + sqrt(dB*dB - dC);
+
+    dDomeAz = atan2(dOrigin[0] + dT*dPointing[0], dOrigin[1] + dT*dPointing[1]) * RAD_TO_DEG;
+    while(dDomeAz < 0)
+        dDomeAz += 360;
+    while(dDomeAz >= 360)
+        dDomeAz -= 360;
+    return dDomeAz;
+}
@@ -0,0 +1,46 @@
+//
+//  DomeGeometry.h
+//  RTI-Dome X2 plugin
+//
+//  Computes the dome azimuth the slit needs to be at for an off-centre German equatorial mount.
+//  Distances are in any unit as long as they are all the same (mm, cm, m).
+//  Frame : origin at the dome centre (intersection of the dome rotation axis and the springline),
+//  x to the East, y to the North, z up.
+//
+
+#ifndef __DomeGeometry__
+#define __DomeGeometry__
+
+#include <math.h>
+
+enum PierSides {PIER_EAST = 0, PIER_WEST};  // side of the pier the telescope is on
+
+class CDomeGeometry
+{
+public:
+    CDomeGeometry();
+
+    // a dome radius of 0 disables the geometry, the telescope azimuth is used as is.
+    void    setGeometry(double dLatitude, double dDomeRadius, double dMountEast, double dMountNorth, double dMountUp, double dGemArm);
+    // hour angle (in hours) at which the mount does its meridian flip
+    void    setFlipHourAngle(double dFlipHA) { m_dFlipHA = dFlipHA; }
+    bool    isEnabled() { return m_dDomeRadius > 0; }
+
+    // dome azimuth for the telescope pointing at dTelAz/dTelAlt (degrees)
+    double  getDomeAz(double dTelAz, double dTelAlt);
+    double  getDomeAz(double dTelAz, double dTelAlt, int nPierSide);
+
+    void    azAltToHaDec(double dAz, double dAlt, double &dHA, double &dDec);
+    int     getPierSide(double dHA);
+
+protected:
+    double  m_dLatitude;        // radians
+    double  m_dDomeRadius;
+    double  m_dMountEast;       // intersection of the RA and Dec axis
+    double  m_dMountNorth;
+    double  m_dMountUp;
+    double  m_dGemArm;          // distance from the RA axis to the optical axis along the Dec axis
+    double  m_dFlipHA;          // hours
+};
+
+#endif
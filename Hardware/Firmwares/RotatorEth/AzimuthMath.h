@@ -0,0 +1,81 @@
+// Rodolphe Pineau
+// Fixed point azimuth math : positions are in steps, azimuths in 1/100 degree.
+// Integer only as the Due has no FPU, with int64 intermediates so big steps per rotation don't overflow.
+// Doesn't depend on Arduino so Tools/RTI-AzimuthMath can test and time it on the host.
+//
+
+#ifndef AzimuthMath_h
+#define AzimuthMath_h
+
+#include <stdint.h>
+
+#define CENTIDEG_PER_TURN   36000L  // azimuths are kept in 1/100 degree
+
+// position in [0, stepsPerRotation[
+long wrapSteps(long position, const long stepsPerRotation)
+{
+    if (stepsPerRotation <= 0)
+        return position;
+
+    position %= stepsPerRotation;
+    if (position < 0)
+        position += stepsPerRotation;
+    return position;
+}
+
+// rounded to the nearest 1/100 degree, in [0, CENTIDEG_PER_TURN[
+long stepsToCentiDeg(const long position, const long stepsPerRotation)
+{
+    if (stepsPerRotation <= 0)
+        return 0;
+
+    return (long)(((int64_t)wrapSteps(position, stepsPerRotation) * CENTIDEG_PER_TURN + stepsPerRotation / 2) / stepsPerRotation) % CENTIDEG_PER_TURN;
+}
+
+// rounded to the nearest step, so converting the result back gives the same azimuth
+long centiDegToSteps(long centiDeg, const long stepsPerRotation)
+{
+    centiDeg %= CENTIDEG_PER_TURN;
+    if (centiDeg < 0)
+        centiDeg += CENTIDEG_PER_TURN;
+    return (long)(((int64_t)centiDeg * stepsPerRotation + CENTIDEG_PER_TURN / 2) / CENTIDEG_PER_TURN);
+}
+
+// "123.45" to 12345 without going through a float, rounded on the 3rd decimal.
+// Stops at the first character that isn't part of the number.
+long parseCentiDeg(const char *pszValue)
+{
+    long nValue = 0;
+    int nDecimals = -1;
+    bool bNegative = false;
+    int i;
+    char c;
+
+    for(i = 0; pszValue[i]; i++) {
+        c = pszValue[i];
+        if (c == '-' && i == 0)
+            bNegative = true;
+        else if (c == '.' && nDecimals < 0)
+            nDecimals = 0;
+        else if (c >= '0' && c <= '9') {
+            if (nDecimals >= 2) {
+                if (nDecimals == 2 && c >= '5')
+                    nValue++;
+                nDecimals = 3;
+                continue;
+            }
+            nValue = nValue * 10 + (c - '0');
+            if (nDecimals >= 0)
+                nDecimals++;
+        }
+        else
+            break;
+    }
+    if (nDecimals < 0)
+        nDecimals = 0;
+    while (nDecimals++ < 2)
+        nValue *= 10;
+    return bNegative ? -nValue : nValue;
+}
+
+#endif // AzimuthMath_h
@@ -28,6 +28,7 @@ public:
 	String	watchdogInterval = "90"; // set proper default.. just in case.
 	String  panid = "0000";
 	String  lowVoltStateOrRaining = "";
+	String  configBlob = "";
 	RemoteShutterClass();
 };
 
@@ -18,9 +18,13 @@ DueFlashStorage dueFlashStorage;
 
 #include <AccelStepper.h>
 #include "StopWatch.h"
+#include <VoltageFilter.h>  // in Hardware/Firmwares/libraries
+#include <ConfigBlob.h>     // in Hardware/Firmwares/libraries
+#include "AzimuthMath.h"
 
 // set this to match the type of steps configured on the
 // stepper controller
+// The plugin goto tolerance uses the same value (DOME_STEP_TYPE in RTI-Dome.h), change both.
 #define STEP_TYPE 8
 
 // #define DEBUG   // enable debug to DebugPort serial port
@@ -67,9 +71,28 @@ Micro-steps per rotation with original motor and 15.3:1 gearbox
 
 #define STEPS_DEFAULT       440640
 
+#define MIN_TELEMETRY_INTERVAL  100 // ms
+
+// two speed homing : fast approach to this far before the home edge, then capture it at maxSpeed / HOMING_SLOW_DIVIDER
+#define HOMING_BACKOFF_CENTIDEG 300 // 3 degrees
+#define HOMING_SLOW_DIVIDER     8
+
+// single pass calibration : home sensor edges closer than this are the sensor bouncing
+#define CALIBRATION_EDGE_DEBOUNCE   100 // steps
+// the rising and falling edge revolutions need to agree within steps per rotation / CALIBRATION_SPREAD_DIVIDER
+#define CALIBRATION_SPREAD_DIVIDER  1000
+
+// drift correction when passing home during normal moves, slip smaller than the dead band is edge noise
+// and slip larger than the max is more likely a false trigger than lost steps.
+#define DRIFT_DEADBAND_CENTIDEG     2
+#define DRIFT_MAX_CENTIDEG          500
+
+// the rain sensor output needs to be stable that long before we change the rain status
+#define RAIN_DEBOUNCE_MS    2000
+
 // used to offset the config location.. at some point.
 #define EEPROM_LOCATION     0  // not used with Arduino Due flash
-#define EEPROM_SIGNATURE    2645
+#define EEPROM_SIGNATURE    2646
 
 #ifdef USE_ETHERNET
 typedef struct IPCONFIG {
@@ -79,6 +102,13 @@ typedef struct IPCONFIG {
     IPAddress       gateway;
     IPAddress       subnet;
 } IPConfig;
+
+// UDP telemetry destination, interval 0 means disabled
+typedef struct TELEMETRYCONFIG {
+    unsigned long   interval;   // ms
+    IPAddress       ip;         // unicast or multicast
+    uint16_t        port;
+} TelemetryConfig;
 #endif
 
 typedef struct RotatorConfiguration {
@@ -96,23 +126,58 @@ typedef struct RotatorConfiguration {
 #endif
 #ifdef USE_ETHERNET
     IPConfig        ipConfig;
+    TelemetryConfig telemetry;
 #endif
 } Configuration;
 
+// config blob tags, never reuse one, new ones go at the end.
+enum RotatorConfigTags { ROTATOR_TAG_STEPS = 1, ROTATOR_TAG_ACCELERATION, ROTATOR_TAG_MAX_SPEED, ROTATOR_TAG_REVERSED, ROTATOR_TAG_HOMEAZ, ROTATOR_TAG_PARKAZ,
+                        ROTATOR_TAG_CUTOFF, ROTATOR_TAG_RAIN_ACTION, ROTATOR_TAG_PANID, ROTATOR_TAG_DHCP, ROTATOR_TAG_IP, ROTATOR_TAG_DNS, ROTATOR_TAG_GATEWAY,
+                        ROTATOR_TAG_SUBNET, ROTATOR_TAG_TELEMETRY_INTERVAL, ROTATOR_TAG_TELEMETRY_IP, ROTATOR_TAG_TELEMETRY_PORT };
+
 
 enum HomeStatuses { NOT_AT_HOME, HOMED, ATHOME };
 enum Seeks { HOMING_NONE,           // Not homing or calibrating
             HOMING_HOME,            // Homing
             HOMING_FINISH,          // found home
             HOMING_BACK_HOME,       //backing out to home Az
+            HOMING_FAST_APPROACH,   // full speed, shortest way, to just before the home edge
+            HOMING_BACK_OFF,        // we went over the edge during the fast approach, backing off
+            HOMING_SLOW_SEEK,       // slow positive move to capture the home edge
             CALIBRATION_MOVE_OFF,    // Ignore home until we've moved off while measuring the dome.
             CALIBRATION_STEP1,      // this is the mode until we hit the home sensor on the first pass
             CALIBRATION_MOVE_OFF2,   // we need to clear the home sensor again
-            CALIBRATION_MEASURE     // Measuring dome until home hit again.
+            CALIBRATION_MEASURE,    // Measuring dome until home hit again.
+            CALIBRATION_EDGES,      // single pass, recording both edges of the home magnet
+            CALIBRATION_APPROACH    // full speed, shortest way, to just before the home edge before recording them
 };
 
 enum RainActions {DO_NOTHING=0, HOME, PARK};
 
+// waypoint queue, segments are executed back to back by Run
+#define MAX_WAYPOINTS   8
+enum WaypointTypes { WAYPOINT_HOME, WAYPOINT_GOTO, WAYPOINT_SYNC, WAYPOINT_WAIT };
+enum WaypointStatuses { WAYPOINTS_IDLE, WAYPOINTS_RUNNING, WAYPOINTS_CANCELLED };
+
+typedef struct WAYPOINT {
+    int     type;
+    long    value;  // centidegrees for goto and sync, ms for wait
+} Waypoint;
+
+// Motion state published by the stepper interrupt, or by Run while the motor timer is stopped.
+// There are 2 buffers, the writer fills the one not being read and its version is odd while it does,
+// readers copy the published one and retry if its version changed. No need to disable interrupts.
+typedef struct MOTIONSTATE {
+    unsigned long   version;
+    long            position;   // raw stepper position
+    float           speed;      // steps/s
+    int             direction;
+    int             seekMode;
+    int             homeStatus;
+    bool            homeFound;
+    long            azimuth;    // centidegrees, filled by GetMotionState
+} MotionState;
+
 
 AccelStepper stepper(AccelStepper::DRIVER, STEP_PIN, DIRECTION_PIN);
 
@@ -162,6 +227,20 @@ uint8_t pickClock(uint32_t frequency, uint32_t& retRC)
 }
 
 
+inline void putLE16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+}
+
+inline void putLE32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+    buffer[2] = (value >> 16) & 0xFF;
+    buffer[3] = (value >> 24) & 0xFF;
+}
+
 void startTimer(Tc *tc, uint32_t channel, IRQn_Type irq, uint32_t frequency)
 {
     uint32_t rc = 0;
@@ -186,11 +265,23 @@ void stopTimer(Tc *tc, uint32_t channel, IRQn_Type irq)
     TC_Stop(tc, channel);
 }
 
+void publishMotionState();
+
 // DUE stepper callback
 void TC3_Handler()
 {
     TC_GetStatus(TC1, 0);
     stepper.run();
+    publishMotionState();
+}
+
+VoltageFilter voltsFilter;
+
+// DUE battery voltage sampling callback
+void TC4_Handler()
+{
+    TC_GetStatus(TC1, 1);
+    voltsFilter.sample();
 }
 
 
@@ -202,6 +293,12 @@ public:
     RotatorClass();
 
     void		SaveToEEProm();
+    uint16_t    GetConfigCRC();
+    // the setters called in between only change m_Config, EndConfigUpdate saves it once
+    void        BeginConfigUpdate();
+    void        EndConfigUpdate();
+    String      GetConfigBlob();
+    bool        SetConfigBlob(const String &sHex);
 
     // rain sensor methods
     bool		GetRainStatus();
@@ -221,13 +318,29 @@ public:
     long        GetAzimuthToPosition(const float);
     void        SyncPosition(const float);
     void        GoToAzimuth(const float);
+    // fixed point versions, azimuth in 1/100 degree
+    long        GetAzimuthCentiDeg();
+    long        CentiDegToPosition(long);
+    void        SyncPositionCentiDeg(long);
+    void        GoToAzimuthCentiDeg(long);
 
     bool        GetReversed();
     void        SetReversed(const bool reversed);
     int         GetDirection();
 
+    // waypoint queue
+    void        ClearWaypoints();
+    bool        AddWaypoint(const int nType, const long nValue);
+    void        StartWaypoints();
+    String      GetWaypointStatus();
+
+    // consistent position, speed, direction, seek mode and home state
+    void        GetMotionState(MotionState &state);
+    void        PublishMotionState();
+
     long        GetStepsPerRotation();
     void        SetStepsPerRotation(const long);
+    long        WrapPosition(long);
 
     int         restoreDefaultMotorSettings();
 
@@ -238,6 +351,7 @@ public:
     void        SetLowVoltageCutoff(const int);
     bool        GetVoltsAreLow();
     String      GetVoltString();
+    int         GetVolts();
 
 
     // home and park methods
@@ -260,6 +374,10 @@ public:
     void        StartHoming();
     void        StartCalibrating();
     void        Calibrate();
+    void        StartTwoPassCalibrating();
+    String      GetHomingDiagnostics();
+    String      GetSlipStats();
+    void        ResetSlipStats();
 
     // Movers
     void        EnableMotor(const bool);
@@ -287,6 +405,10 @@ public:
     String      getIPGateway();
     void        setIPGateway(String ipGateway);
     String      IpAddress2String(const IPAddress& ipAddress);
+
+    void        getTelemetryConfig(TelemetryConfig &config);
+    String      getTelemetryConfigString();
+    bool        setTelemetryConfigString(String sConfig);
 #endif
 
 private:
@@ -299,24 +421,72 @@ private:
     bool            m_bSetToHomeAzimuth;
     bool            m_bDoStepsPerRotation;
 
-    float           m_fStepsPerDegree;
     StopWatch       m_MoveOffUntilTimer;
     unsigned long   m_nMOVE_OFFUntilLapse = 2000;
     int             m_nMoveDirection;
 
+    Waypoint        m_Waypoints[MAX_WAYPOINTS];
+    int             m_nWaypoints;
+    int             m_nCurrentWaypoint;
+    int             m_nWaypointStatus;
+    bool            m_bWaypointStarted;
+    bool            m_bBackHomeIsHome;  // false when a goto waypoint replaced the move back to home
+    StopWatch       m_WaypointTimer;
+    void            RunWaypoints();
+    void            StartWaypoint();
+
+    volatile MotionState    m_MotionStates[2];
+    volatile int    m_nMotionStateIndex;    // the published one
+    volatile bool   m_bMotorTimerRunning;   // the stepper interrupt publishes the motion state
+    volatile bool   m_bHomePinLow;          // tracked by homeInterrupt
+
 	volatile long	m_nStepsAtHome;
     volatile long	m_nHomePosEdgePass1;
     volatile long	m_nHomePosEdgePass2;
     volatile bool	m_HomeFound;
 
+    // two speed homing and its diagnostics
+    void            ContinueHoming();
+    bool            m_bPositionKnown;   // we've seen the home edge since power on
+    bool            m_bHoming;
+    bool            m_bTwoSpeedHoming;
+    volatile bool   m_bHomingEdgeSeen;
+    volatile long   m_nHomingFastEdge;
+    StopWatch       m_HomingTimer;
+    unsigned long   m_nHomingTime;
+    long            m_nEdgeError;
+    long            m_nEdgeErrorMin;
+    long            m_nEdgeErrorMax;
+    unsigned long   m_nEdgeCaptures;
+
+    // single pass calibration, accepted edges alternate so 0/2 and 1/3 are the same edge one turn apart
+    void            calibrationEdge(const long nPos, const bool bFalling);
+    void            StartEdgeCalibration();
+    void            FinishEdgeCalibration();
+    volatile long   m_nCalEdgePos[4];
+    volatile unsigned long  m_nCalEdgeTime[4];  // us
+    volatile int    m_nCalEdges;
+    volatile bool   m_bCalFirstFalling;
+    long            m_nCalMagnetWidth;
+    long            m_nCalSpread;
+    unsigned long   m_nCalRevTime;
+    bool            m_bCalSinglePass;
+
+    // drift correction from home crossings during normal moves
+    void            CorrectDrift(const long nPos, const int nDirection);
+    volatile bool   m_bDriftEdgePending;
+    volatile long   m_nDriftEdgePos;
+    volatile int    m_nDriftEdgeDirection;
+    long            m_nLastDriftEdge;
+    long            m_nDriftPending;    // applied to the position once we stop
+    unsigned long   m_nDriftCrossings;
+    unsigned long   m_nDriftRejected;
+    long            m_nDriftLast;
+    long            m_nDriftMax;
+    long            m_nDriftTotal;
+
     // Power values
     float           m_fAdcConvert;
-    int             m_nVolts;
-    int             ReadVolts();
-
-
-    StopWatch       m_periodicReadingTimer;
-    unsigned long   m_nNextPeriodicReadingLapse = 10;
 
 
     // Utility
@@ -324,6 +494,8 @@ private:
     void        SetDefaultConfig();
 
     volatile bool        m_bIsRaining;
+    volatile bool        m_bRainPinState;
+    volatile unsigned long  m_nRainEdgeTime;
 
     bool        m_bDoEEPromSave;
 #ifdef USE_EXT_EEPROM
@@ -340,6 +512,15 @@ private:
 
 
 
+// the stepper interrupt publishes this rotator's motion state
+RotatorClass *motionSource = NULL;
+
+void publishMotionState()
+{
+    if (motionSource)
+        motionSource->PublishMotionState();
+}
+
 RotatorClass::RotatorClass()
 {
 #ifdef USE_EXT_EEPROM
@@ -356,6 +537,37 @@ RotatorClass::RotatorClass()
     m_bSetToHomeAzimuth = false;
     m_bDoStepsPerRotation = false;
     m_nMoveDirection = MOVE_NONE;
+    memset((void *)m_MotionStates, 0, sizeof(m_MotionStates));
+    m_nMotionStateIndex = 0;
+    m_bMotorTimerRunning = false;
+    m_nWaypoints = 0;
+    m_nCurrentWaypoint = 0;
+    m_nWaypointStatus = WAYPOINTS_IDLE;
+    m_bWaypointStarted = false;
+    m_bBackHomeIsHome = true;
+    m_bHomePinLow = false;
+    m_bPositionKnown = false;
+    m_bHoming = false;
+    m_bTwoSpeedHoming = false;
+    m_bHomingEdgeSeen = false;
+    m_nHomingFastEdge = 0;
+    m_nHomingTime = 0;
+    m_nEdgeError = 0;
+    m_nEdgeErrorMin = 0;
+    m_nEdgeErrorMax = 0;
+    m_nEdgeCaptures = 0;
+    m_nCalEdges = 0;
+    m_bCalFirstFalling = false;
+    m_nCalMagnetWidth = 0;
+    m_nCalSpread = 0;
+    m_nCalRevTime = 0;
+    m_bCalSinglePass = false;
+    m_bDriftEdgePending = false;
+    m_nDriftEdgePos = 0;
+    m_nDriftEdgeDirection = MOVE_NONE;
+    m_nLastDriftEdge = 0;
+    m_nDriftPending = 0;
+    ResetSlipStats();
 
     // input
 
@@ -395,6 +607,8 @@ RotatorClass::RotatorClass()
     else {
         m_bIsRaining = false;
     }
+    m_bRainPinState = m_bIsRaining;
+    m_nRainEdgeTime = millis();
 
     if(digitalRead(HOME_PIN) == LOW) {
         // we're at the home position
@@ -408,27 +622,49 @@ RotatorClass::RotatorClass()
         DBPrintln("At park on startup");
     }
 
-    m_fAdcConvert = RES_MULT * (AD_REF / 1023.0) * 100;
+    m_fAdcConvert = RES_MULT * (AD_REF / VOLTS_ADC_MAX) * 100;
+    voltsFilter.begin(VOLTAGE_MONITOR_PIN, m_fAdcConvert);
+    startTimer(TC1, 1, TC4_IRQn, VOLTS_SAMPLE_FREQ);
 
 
     // reset all timers
     m_MoveOffUntilTimer.reset();
-    m_periodicReadingTimer.reset();
+
+    m_bHomePinLow = (digitalRead(HOME_PIN) == LOW);
+    PublishMotionState();
+    motionSource = this;
 }
 
 
 inline void RotatorClass::homeInterrupt()
 {
     long  nPos;
-
-	// debounce
-	if (digitalRead(HOME_PIN) != LOW)
-		return;
+    bool  bFalling;
 
     nPos = stepper.currentPosition(); // read position immediately
+    bFalling = (digitalRead(HOME_PIN) == LOW);
+    m_bHomePinLow = bFalling;
+
+    if (m_seekMode == CALIBRATION_EDGES) {
+        calibrationEdge(nPos, bFalling);
+        return;
+    }
+
+	// debounce, everything else only uses the falling edge
+	if (!bFalling)
+		return;
 
     switch(m_seekMode) {
+        case HOMING_FAST_APPROACH: // only the edge we capture when moving positive counts
+            if (m_nMoveDirection == MOVE_POSITIVE) {
+                m_nHomingFastEdge = nPos;
+                m_bHomingEdgeSeen = true;
+                motorStop();
+            }
+            break;
+
         case HOMING_HOME: // stop and take note of where we are so we can reverse.
+        case HOMING_SLOW_SEEK:
             m_nStepsAtHome = nPos;
             motorStop();
             m_HomeFound = true;
@@ -446,20 +682,44 @@ inline void RotatorClass::homeInterrupt()
             motorStop();
             break;
 
-        default: // resync
+        case HOMING_NONE: // note where we crossed home, Run does the drift correction
             // SyncPosition(m_Config.homeAzimuth); // THIS STOPS THE MOTOR :( Thanks AccelStepper :((
+            if (m_bPositionKnown && m_nMoveDirection != MOVE_NONE && !m_bDriftEdgePending) {
+                m_nDriftEdgePos = nPos;
+                m_nDriftEdgeDirection = m_nMoveDirection;
+                m_bDriftEdgePending = true;
+            }
+            break;
+
+        default:
             break;
     }
 }
 
 
+inline void RotatorClass::calibrationEdge(const long nPos, const bool bFalling)
+{
+    // edges have to alternate and be a bit apart, anything else is the sensor bouncing
+    if (m_nCalEdges >= 4)
+        return;
+    if (m_nCalEdges && (bFalling == ((m_nCalEdges & 1) ? m_bCalFirstFalling : !m_bCalFirstFalling) ||
+                        labs(nPos - m_nCalEdgePos[m_nCalEdges-1]) < CALIBRATION_EDGE_DEBOUNCE))
+        return;
+
+    if (!m_nCalEdges)
+        m_bCalFirstFalling = bFalling;
+    m_nCalEdgePos[m_nCalEdges] = nPos;
+    m_nCalEdgeTime[m_nCalEdges] = micros();
+    m_nCalEdges++;
+    if (m_nCalEdges == 4) // both edges seen twice, we have one full turn for each
+        motorStop();
+}
+
+// only record the edge, GetRainStatus does the debouncing
 inline void RotatorClass::rainInterrupt()
 {
-    if (digitalRead(RAIN_SENSOR_PIN) == LOW) {
-        m_bIsRaining = true;
-    }
-    else
-        m_bIsRaining = false;
+    m_bRainPinState = (digitalRead(RAIN_SENSOR_PIN) == LOW);
+    m_nRainEdgeTime = millis();
 }
 
 void RotatorClass::SaveToEEProm()
@@ -480,6 +740,149 @@ void RotatorClass::SaveToEEProm()
 #endif
 }
 
+void RotatorClass::BeginConfigUpdate()
+{
+    m_bDoEEPromSave = false;
+}
+
+void RotatorClass::EndConfigUpdate()
+{
+    m_bDoEEPromSave = true;
+    SaveToEEProm();
+}
+
+// all the settings, see ConfigBlob.h. Azimuths are in 1/100 degree.
+String RotatorClass::GetConfigBlob()
+{
+    ConfigBlob blob(CONFIG_BLOB_ROTATOR);
+
+    blob.add(ROTATOR_TAG_STEPS, m_Config.stepsPerRotation, 4);
+    blob.add(ROTATOR_TAG_ACCELERATION, m_Config.acceleration, 4);
+    blob.add(ROTATOR_TAG_MAX_SPEED, m_Config.maxSpeed, 4);
+    blob.add(ROTATOR_TAG_REVERSED, m_Config.reversed, 1);
+    blob.add(ROTATOR_TAG_HOMEAZ, (unsigned long)(m_Config.homeAzimuth * 100 + 0.5), 2);
+    blob.add(ROTATOR_TAG_PARKAZ, (unsigned long)(m_Config.parkAzimuth * 100 + 0.5), 2);
+    blob.add(ROTATOR_TAG_CUTOFF, m_Config.cutOffVolts, 2);
+    blob.add(ROTATOR_TAG_RAIN_ACTION, m_Config.rainAction, 1);
+#ifndef STANDALONE
+    blob.add(ROTATOR_TAG_PANID, m_Config.panid, 2);
+#endif
+#ifdef USE_ETHERNET
+    blob.add(ROTATOR_TAG_DHCP, m_Config.ipConfig.bUseDHCP, 1);
+    blob.add(ROTATOR_TAG_IP, (uint32_t)m_Config.ipConfig.ip, 4);
+    blob.add(ROTATOR_TAG_DNS, (uint32_t)m_Config.ipConfig.dns, 4);
+    blob.add(ROTATOR_TAG_GATEWAY, (uint32_t)m_Config.ipConfig.gateway, 4);
+    blob.add(ROTATOR_TAG_SUBNET, (uint32_t)m_Config.ipConfig.subnet, 4);
+    blob.add(ROTATOR_TAG_TELEMETRY_INTERVAL, m_Config.telemetry.interval, 4);
+    blob.add(ROTATOR_TAG_TELEMETRY_IP, (uint32_t)m_Config.telemetry.ip, 4);
+    blob.add(ROTATOR_TAG_TELEMETRY_PORT, m_Config.telemetry.port, 2);
+#endif
+    return blob.toHex();
+}
+
+// Everything is checked before anything changes and the config is saved once.
+// The PAN ID is only there for reference, changing it needs both XBees to be reconfigured (see PANID_GET).
+// The network settings are used on the next ethernet reconfiguration, like when they're set one by one.
+bool RotatorClass::SetConfigBlob(const String &sHex)
+{
+    ConfigBlob blob(CONFIG_BLOB_ROTATOR);
+    Configuration newConfig;
+    uint8_t nTag;
+    unsigned long nValue;
+
+    if(!blob.fromHex(sHex))
+        return false;
+
+    // settings that are not in the blob keep their current value
+    memcpy(&newConfig, &m_Config, sizeof(Configuration));
+    while(blob.next(nTag, nValue)) {
+        switch(nTag) {
+            case ROTATOR_TAG_STEPS:
+                newConfig.stepsPerRotation = (long)nValue;
+                break;
+            case ROTATOR_TAG_ACCELERATION:
+                newConfig.acceleration = (long)nValue;
+                break;
+            case ROTATOR_TAG_MAX_SPEED:
+                newConfig.maxSpeed = (long)nValue;
+                break;
+            case ROTATOR_TAG_REVERSED:
+                newConfig.reversed = (nValue != 0);
+                break;
+            case ROTATOR_TAG_HOMEAZ:
+                newConfig.homeAzimuth = nValue / 100.0;
+                break;
+            case ROTATOR_TAG_PARKAZ:
+                newConfig.parkAzimuth = nValue / 100.0;
+                break;
+            case ROTATOR_TAG_CUTOFF:
+                newConfig.cutOffVolts = (int)nValue;
+                break;
+            case ROTATOR_TAG_RAIN_ACTION:
+                newConfig.rainAction = (int)nValue;
+                break;
+#ifdef USE_ETHERNET
+            case ROTATOR_TAG_DHCP:
+                newConfig.ipConfig.bUseDHCP = (nValue != 0);
+                break;
+            case ROTATOR_TAG_IP:
+                newConfig.ipConfig.ip = IPAddress((uint32_t)nValue);
+                break;
+            case ROTATOR_TAG_DNS:
+                newConfig.ipConfig.dns = IPAddress((uint32_t)nValue);
+                break;
+            case ROTATOR_TAG_GATEWAY:
+                newConfig.ipConfig.gateway = IPAddress((uint32_t)nValue);
+                break;
+            case ROTATOR_TAG_SUBNET:
+                newConfig.ipConfig.subnet = IPAddress((uint32_t)nValue);
+                break;
+            case ROTATOR_TAG_TELEMETRY_INTERVAL:
+                newConfig.telemetry.interval = nValue;
+                break;
+            case ROTATOR_TAG_TELEMETRY_IP:
+                newConfig.telemetry.ip = IPAddress((uint32_t)nValue);
+                break;
+            case ROTATOR_TAG_TELEMETRY_PORT:
+                newConfig.telemetry.port = (uint16_t)nValue;
+                break;
+#endif
+            default: // PAN ID or a tag from a newer firmware
+                break;
+        }
+    }
+
+    if(newConfig.stepsPerRotation <= 0 || newConfig.acceleration <= 0 || newConfig.maxSpeed <= 0)
+        return false;
+    if(newConfig.homeAzimuth >= 360 || newConfig.parkAzimuth >= 360)
+        return false;
+    if(newConfig.cutOffVolts < 0 || newConfig.rainAction < DO_NOTHING || newConfig.rainAction > PARK)
+        return false;
+#ifdef USE_ETHERNET
+    if(newConfig.telemetry.port == 0)
+        return false;
+    if(newConfig.telemetry.interval > 0 && newConfig.telemetry.interval < MIN_TELEMETRY_INTERVAL)
+        newConfig.telemetry.interval = MIN_TELEMETRY_INTERVAL;
+#endif
+
+    memcpy(&m_Config, &newConfig, sizeof(Configuration));
+    stepper.setAcceleration(m_Config.acceleration);
+    stepper.setMaxSpeed(m_Config.maxSpeed);
+    stepper.setPinsInverted(m_Config.reversed, m_Config.reversed, m_Config.reversed);
+    SaveToEEProm();
+    return true;
+}
+
+// changes every time something is saved to the EEPROM, used by the plugin to validate its cached config
+// over the same field by field dump as the configuration blob, the raw struct has padding and the IPAddress vtables
+uint16_t RotatorClass::GetConfigCRC()
+{
+    String sBlob;
+
+    sBlob = GetConfigBlob();
+    return crc16((const uint8_t *)sBlob.c_str(), sBlob.length());
+}
+
 bool RotatorClass::LoadFromEEProm()
 {
     bool response = true;
@@ -526,6 +929,9 @@ void RotatorClass::SetDefaultConfig()
     m_Config.ipConfig.dns.fromString("192.168.0.1");
     m_Config.ipConfig.gateway.fromString("192.168.0.1");
     m_Config.ipConfig.subnet.fromString("255.255.255.0");
+    m_Config.telemetry.interval = 0;
+    m_Config.telemetry.ip.fromString("239.255.42.42");
+    m_Config.telemetry.port = 2324;
 #endif
 }
 
@@ -591,6 +997,54 @@ void RotatorClass::setIPGateway(String ipGateway)
     SaveToEEProm();
 }
 
+void RotatorClass::getTelemetryConfig(TelemetryConfig &config)
+{
+    config.interval = m_Config.telemetry.interval;
+    config.ip = m_Config.telemetry.ip;
+    config.port = m_Config.telemetry.port;
+}
+
+// interval,ip,port
+String RotatorClass::getTelemetryConfigString()
+{
+    return String(m_Config.telemetry.interval) + "," + IpAddress2String(m_Config.telemetry.ip) + "," + String(m_Config.telemetry.port);
+}
+
+bool RotatorClass::setTelemetryConfigString(String sConfig)
+{
+    int nFirstComma, nSecondComma;
+    long nInterval, nPort;
+    IPAddress ip;
+
+    nFirstComma = sConfig.indexOf(',');
+    if(nFirstComma < 0) { // only the interval
+        nInterval = sConfig.toInt();
+        ip = m_Config.telemetry.ip;
+        nPort = m_Config.telemetry.port;
+    }
+    else {
+        nSecondComma = sConfig.indexOf(',', nFirstComma + 1);
+        if(nSecondComma < 0)
+            return false;
+        nInterval = sConfig.substring(0, nFirstComma).toInt();
+        if(!ip.fromString(sConfig.substring(nFirstComma + 1, nSecondComma)))
+            return false;
+        nPort = sConfig.substring(nSecondComma + 1).toInt();
+    }
+
+    if(nInterval < 0 || nPort <= 0 || nPort > 65535)
+        return false;
+    if(nInterval > 0 && nInterval < MIN_TELEMETRY_INTERVAL)
+        nInterval = MIN_TELEMETRY_INTERVAL;
+
+    m_Config.telemetry.interval = nInterval;
+    m_Config.telemetry.ip = ip;
+    m_Config.telemetry.port = nPort;
+    DBPrintln("New telemetry config : " + getTelemetryConfigString());
+    SaveToEEProm();
+    return true;
+}
+
 String RotatorClass::IpAddress2String(const IPAddress& ipAddress)
 {
     return String() + ipAddress[0] + "." + ipAddress[1] + "." + ipAddress[2] + "." + ipAddress[3];;
@@ -602,11 +1056,22 @@ String RotatorClass::IpAddress2String(const IPAddress& ipAddress)
 //
 bool RotatorClass::GetRainStatus()
 {
-    if (digitalRead(RAIN_SENSOR_PIN) == LOW) {
-        m_bIsRaining = true;
+    bool bPinState;
+
+    bPinState = (digitalRead(RAIN_SENSOR_PIN) == LOW);
+    if(bPinState != m_bRainPinState) {
+        // we missed the interrupt, use this as the edge time
+        noInterrupts();
+        m_bRainPinState = bPinState;
+        m_nRainEdgeTime = millis();
+        interrupts();
+    }
+
+    // only change state once the sensor output has been stable for RAIN_DEBOUNCE_MS
+    if(m_bRainPinState != m_bIsRaining && (millis() - m_nRainEdgeTime) >= RAIN_DEBOUNCE_MS) {
+        m_bIsRaining = m_bRainPinState;
+        DBPrintln("Rain status changed to " + String(m_bIsRaining));
     }
-    else
-        m_bIsRaining = false;
 
     return m_bIsRaining;
 }
@@ -649,19 +1114,20 @@ void RotatorClass::SetMaxSpeed(const long newSpeed)
     SaveToEEProm();
 }
 
+// position in [0, stepsPerRotation[
+long RotatorClass::WrapPosition(long position)
+{
+    return wrapSteps(position, m_Config.stepsPerRotation);
+}
+
 long RotatorClass::GetPosition()
 {
     /// Return change in steps relative to
     /// last sync position
     long position;
     position = stepper.currentPosition();
-    if (m_seekMode < CALIBRATION_MOVE_OFF) {
-        while (position >= m_Config.stepsPerRotation)
-            position -= m_Config.stepsPerRotation;
-
-        while (position < 0)
-            position += m_Config.stepsPerRotation;
-    }
+    if (m_seekMode < CALIBRATION_MOVE_OFF)
+        position = WrapPosition(position);
 
     return position;
 }
@@ -669,49 +1135,54 @@ long RotatorClass::GetPosition()
 
 float RotatorClass::GetAzimuth()
 {
-    double azimuth = 0.0;
-    long currentPosition = 0;
-
-    currentPosition = GetPosition();
-    if (currentPosition != 0)
-        azimuth = (double)currentPosition / (double)m_Config.stepsPerRotation * 360.0;
-
-    while (azimuth < 0.0)
-        azimuth += 360.0;
+    return (float)GetAzimuthCentiDeg() / 100.0;
+}
 
-    while (azimuth >= 360.0) {
-        azimuth -= 360.0;
-    }
+// rounded to the nearest 1/100 degree, integer math only (no FPU on the Due)
+long RotatorClass::GetAzimuthCentiDeg()
+{
+    return stepsToCentiDeg(GetPosition(), m_Config.stepsPerRotation);
+}
 
-    return float(azimuth);
+// rounded to the nearest step, so converting the result back gives the same azimuth
+long RotatorClass::CentiDegToPosition(long centiDeg)
+{
+    return centiDegToSteps(centiDeg, m_Config.stepsPerRotation);
 }
 
 long RotatorClass::GetAzimuthToPosition(const float azimuth)
 {
-    long newPosition;
-
-    newPosition = (float)m_Config.stepsPerRotation / (float)360 * azimuth;
-
-    return newPosition;
+    return CentiDegToPosition(lroundf(azimuth * 100.0f));
 }
 
 void RotatorClass::SyncPosition(const float newAzimuth)
 {
-    long newPosition;
+    SyncPositionCentiDeg(lroundf(newAzimuth * 100.0f));
+}
 
-    newPosition = GetAzimuthToPosition(newAzimuth);
-    stepper.setCurrentPosition(newPosition);
+void RotatorClass::SyncPositionCentiDeg(long centiDeg)
+{
+    m_nDriftPending = 0;
+    stepper.setCurrentPosition(CentiDegToPosition(centiDeg));
+    if (!m_bMotorTimerRunning)
+        PublishMotionState(); // so the sync reply sees the new position
 }
 
 void RotatorClass::GoToAzimuth(const float newHeading)
+{
+    GoToAzimuthCentiDeg(lroundf(newHeading * 100.0f));
+}
+
+void RotatorClass::GoToAzimuthCentiDeg(long newHeading)
 {
     // Goto new target
-    float currentHeading;
-    float delta;
+    long delta;
 
-    currentHeading = GetAzimuth();
-    delta = GetAngularDistance(currentHeading, newHeading) * m_fStepsPerDegree;
-    delta = delta - int(delta) % STEP_TYPE;
+    // shortest way, in steps, including any drift correction not applied yet
+    delta = WrapPosition(CentiDegToPosition(newHeading) + m_nDriftPending - GetPosition());
+    if (delta > m_Config.stepsPerRotation / 2)
+        delta -= m_Config.stepsPerRotation;
+    delta = delta - delta % STEP_TYPE;
     if(delta == 0) {
         m_nMoveDirection = MOVE_NONE;
         return;
@@ -737,6 +1208,47 @@ int RotatorClass::GetDirection()
     return m_nMoveDirection;
 }
 
+// single writer : the stepper interrupt when its timer runs, Run otherwise
+void RotatorClass::PublishMotionState()
+{
+    int nIndex = m_nMotionStateIndex ^ 1;
+    volatile MotionState &state = m_MotionStates[nIndex];
+
+    state.version++;    // odd, being written
+    state.position = stepper.currentPosition();
+    state.speed = stepper.speed();
+    state.direction = m_nMoveDirection;
+    state.seekMode = m_seekMode;
+    state.homeStatus = m_bHomePinLow ? ATHOME : NOT_AT_HOME;
+    state.homeFound = m_HomeFound;
+    state.version++;    // even, done
+    m_nMotionStateIndex = nIndex;
+}
+
+void RotatorClass::GetMotionState(MotionState &state)
+{
+    int nIndex;
+    unsigned long nVersion;
+
+    do {
+        nIndex = m_nMotionStateIndex;
+        volatile MotionState &published = m_MotionStates[nIndex];
+        nVersion = published.version;
+        state.position = published.position;
+        state.speed = published.speed;
+        state.direction = published.direction;
+        state.seekMode = published.seekMode;
+        state.homeStatus = published.homeStatus;
+        state.homeFound = published.homeFound;
+    } while ((nVersion & 1) || nVersion != m_MotionStates[nIndex].version);
+    state.version = nVersion;
+
+    // same as GetPosition and GetAzimuthCentiDeg but from the snapshot
+    if (state.seekMode < CALIBRATION_MOVE_OFF)
+        state.position = WrapPosition(state.position);
+    state.azimuth = stepsToCentiDeg(state.position, m_Config.stepsPerRotation);
+}
+
 long RotatorClass::GetStepsPerRotation()
 {
     return m_Config.stepsPerRotation;
@@ -744,7 +1256,6 @@ long RotatorClass::GetStepsPerRotation()
 
 void RotatorClass::SetStepsPerRotation(const long newCount)
 {
-    m_fStepsPerDegree = (float)newCount / 360.0;
     m_Config.stepsPerRotation = newCount;
     SaveToEEProm();
 }
@@ -791,26 +1302,17 @@ void RotatorClass::SetLowVoltageCutoff(const int lowVolts)
 
 inline bool RotatorClass::GetVoltsAreLow()
 {
-    bool voltsLow = false;
-
-    if (m_nVolts <= m_Config.cutOffVolts)
-        voltsLow = true;
-    return voltsLow;
+    return voltsFilter.isLow(m_Config.cutOffVolts);
 }
 
 inline String RotatorClass::GetVoltString()
 {
-    return String(m_nVolts) + "," + String(m_Config.cutOffVolts);
+    return String(voltsFilter.getVolts()) + "," + String(m_Config.cutOffVolts);
 }
 
-int RotatorClass::ReadVolts()
+inline int RotatorClass::GetVolts()
 {
-    int adc;
-    float calc;
-
-    adc = analogRead(VOLTAGE_MONITOR_PIN);
-    calc = adc * m_fAdcConvert;
-    return int(calc);
+    return voltsFilter.getVolts();
 }
 
 //
@@ -881,9 +1383,27 @@ void RotatorClass::setPANID(const String panID)
 //
 void RotatorClass::StartHoming()
 {
-    float diff;
     long distance;
 
+    m_nDriftPending = 0;
+    m_HomingTimer.reset();
+    m_bHoming = true;
+    m_bHomingEdgeSeen = false;
+    m_bTwoSpeedHoming = m_bPositionKnown;
+
+    if (m_bTwoSpeedHoming) {
+        // we know where the edge should be, go there the shortest way at full speed
+        // and stop a bit before it so ContinueHoming can capture it slowly in the positive direction.
+        m_bisAtHome = false;
+        m_HomeFound = false;
+        distance = WrapPosition(GetAzimuthToPosition(m_Config.homeAzimuth) - CentiDegToPosition(HOMING_BACKOFF_CENTIDEG) - GetPosition());
+        if (distance > m_Config.stepsPerRotation / 2)
+            distance -= m_Config.stepsPerRotation;
+        m_seekMode = HOMING_FAST_APPROACH;
+        MoveRelative(distance);
+        return;
+    }
+
     if(digitalRead(HOME_PIN) == LOW) {
         // we're at the home position
         m_bisAtHome = true;
@@ -901,7 +1421,233 @@ void RotatorClass::StartHoming()
     MoveRelative(distance);
 }
 
+void RotatorClass::ContinueHoming()
+{
+    if (m_seekMode == HOMING_FAST_APPROACH && m_bHomingEdgeSeen) {
+        // we were off and ran over the edge at full speed, back off before it.
+        m_bHomingEdgeSeen = false;
+        m_seekMode = HOMING_BACK_OFF;
+        MoveRelative(m_nHomingFastEdge - CentiDegToPosition(HOMING_BACKOFF_CENTIDEG) - stepper.currentPosition());
+        return;
+    }
+    // always capture the edge in the positive direction, same as a normal homing.
+    stepper.setMaxSpeed(max(m_Config.maxSpeed / HOMING_SLOW_DIVIDER, 1L));
+    m_HomeFound = false;
+    m_seekMode = HOMING_SLOW_SEEK;
+    MoveRelative(160000000L);
+}
+
+// last homing time (ms), last edge error (steps), min error, max error, edge captures, two speed used
+// then the last calibration : magnet width (steps), rising/falling turn spread (steps), turn time (ms), single pass used
+String RotatorClass::GetHomingDiagnostics()
+{
+    return String(m_nHomingTime) + "," + String(m_nEdgeError) + "," + String(m_nEdgeErrorMin) + "," +
+            String(m_nEdgeErrorMax) + "," + String(m_nEdgeCaptures) + "," + String(m_bTwoSpeedHoming?1:0) + "," +
+            String(m_nCalMagnetWidth) + "," + String(m_nCalSpread) + "," + String(m_nCalRevTime) + "," + String(m_bCalSinglePass?1:0);
+}
+
+void RotatorClass::CorrectDrift(const long nPos, const int nDirection)
+{
+    long nExpected;
+    long nSlip;
+
+    // the sensor bouncing
+    if (m_nDriftCrossings && labs(nPos - m_nLastDriftEdge) < CALIBRATION_EDGE_DEBOUNCE)
+        return;
+    m_nLastDriftEdge = nPos;
+
+    // moving positive we hit the same edge homing uses, moving negative the other side of the magnet
+    nExpected = GetAzimuthToPosition(m_Config.homeAzimuth);
+    if (nDirection == MOVE_NEGATIVE) {
+        if (!m_nCalMagnetWidth) // we don't know where that edge is
+            return;
+        nExpected += m_nCalMagnetWidth;
+    }
+
+    nSlip = WrapPosition(nPos - m_nDriftPending - nExpected);
+    if (nSlip > m_Config.stepsPerRotation / 2)
+        nSlip -= m_Config.stepsPerRotation;
+    nSlip = nSlip - nSlip % STEP_TYPE; // stay on full steps
+
+    m_nDriftCrossings++;
+    m_nDriftLast = nSlip;
+    if (labs(nSlip) > labs(m_nDriftMax))
+        m_nDriftMax = nSlip;
+
+    if (labs(nSlip) > CentiDegToPosition(DRIFT_MAX_CENTIDEG)) {
+        m_nDriftRejected++;
+        return;
+    }
+    if (labs(nSlip) <= CentiDegToPosition(DRIFT_DEADBAND_CENTIDEG))
+        return;
+
+    // we can't change the position while moving, move the target instead and fix the position once stopped.
+    m_nDriftPending += nSlip;
+    m_nDriftTotal += nSlip;
+    if (stepper.isRunning())
+        stepper.moveTo(stepper.targetPosition() + nSlip);
+}
+
+// home crossings, last slip, largest slip, total correction (steps), rejected crossings
+String RotatorClass::GetSlipStats()
+{
+    return String(m_nDriftCrossings) + "," + String(m_nDriftLast) + "," + String(m_nDriftMax) + "," +
+            String(m_nDriftTotal) + "," + String(m_nDriftRejected);
+}
+
+void RotatorClass::ResetSlipStats()
+{
+    m_nDriftCrossings = 0;
+    m_nDriftRejected = 0;
+    m_nDriftLast = 0;
+    m_nDriftMax = 0;
+    m_nDriftTotal = 0;
+}
+
+void RotatorClass::ClearWaypoints()
+{
+    if (m_nWaypointStatus == WAYPOINTS_RUNNING)
+        m_nWaypointStatus = WAYPOINTS_CANCELLED;
+    m_nWaypoints = 0;
+    m_nCurrentWaypoint = 0;
+    m_bWaypointStarted = false;
+}
+
+bool RotatorClass::AddWaypoint(const int nType, const long nValue)
+{
+    if (m_nWaypointStatus == WAYPOINTS_RUNNING || m_nWaypoints >= MAX_WAYPOINTS)
+        return false;
+    m_Waypoints[m_nWaypoints].type = nType;
+    m_Waypoints[m_nWaypoints].value = nValue;
+    m_nWaypoints++;
+    return true;
+}
+
+void RotatorClass::StartWaypoints()
+{
+    m_nCurrentWaypoint = 0;
+    m_bWaypointStarted = false;
+    m_nWaypointStatus = m_nWaypoints ? WAYPOINTS_RUNNING : WAYPOINTS_IDLE;
+}
+
+// status, current segment, number of segments
+String RotatorClass::GetWaypointStatus()
+{
+    return String(m_nWaypointStatus) + "," + String(m_nCurrentWaypoint) + "," + String(m_nWaypoints);
+}
+
+void RotatorClass::StartWaypoint()
+{
+    Waypoint &waypoint = m_Waypoints[m_nCurrentWaypoint];
+
+    m_bWaypointStarted = true;
+    switch(waypoint.type) {
+        case WAYPOINT_HOME:
+            StartHoming();
+            break;
+        case WAYPOINT_GOTO:
+            GoToAzimuthCentiDeg(waypoint.value);
+            break;
+        case WAYPOINT_SYNC:
+            SyncPositionCentiDeg(waypoint.value);
+            break;
+        case WAYPOINT_WAIT:
+            m_WaypointTimer.reset();
+            break;
+    }
+}
+
+void RotatorClass::RunWaypoints()
+{
+    if (!m_bWaypointStarted) {
+        StartWaypoint();
+        return;
+    }
+
+    // is the current segment done
+    if (m_Waypoints[m_nCurrentWaypoint].type == WAYPOINT_WAIT) {
+        if (m_WaypointTimer.elapsed() < (unsigned long)m_Waypoints[m_nCurrentWaypoint].value)
+            return;
+    }
+    else if (m_seekMode != HOMING_NONE || m_bWasRunning || stepper.isRunning())
+        return;
+
+    m_nCurrentWaypoint++;
+    m_bWaypointStarted = false;
+    if (m_nCurrentWaypoint >= m_nWaypoints) {
+        m_nWaypointStatus = WAYPOINTS_IDLE;
+        m_nWaypoints = 0;
+        m_nCurrentWaypoint = 0;
+    }
+}
+
 void RotatorClass::StartCalibrating()
+{
+    long distance;
+
+    m_bHoming = false;
+    m_nDriftPending = 0;
+    m_bDoStepsPerRotation = false;
+
+    if (m_bPositionKnown) {
+        // same as the two speed homing, get to just before the home edge the shortest way at full speed
+        // so we don't spend up to a turn looking for the first edge. The measure still needs a turn
+        // plus the magnet width after that.
+        distance = WrapPosition(GetAzimuthToPosition(m_Config.homeAzimuth) - CentiDegToPosition(HOMING_BACKOFF_CENTIDEG) - GetPosition());
+        if (distance > m_Config.stepsPerRotation / 2)
+            distance -= m_Config.stepsPerRotation;
+        m_seekMode = CALIBRATION_APPROACH;
+        MoveRelative(distance);
+        return;
+    }
+    StartEdgeCalibration();
+}
+
+void RotatorClass::StartEdgeCalibration()
+{
+    // one turn from the first home edge we see, rising or falling
+    m_nCalEdges = 0;
+    stepper.setCurrentPosition(0);
+    m_seekMode = CALIBRATION_EDGES;
+    MoveRelative(160000000L);
+}
+
+void RotatorClass::FinishEdgeCalibration()
+{
+    long nSprFalling;
+    long nSprRising;
+    long nSteps;
+    int nFirstFalling;
+
+    // 0/2 and 1/3 are the same edge one turn apart
+    nSprFalling = m_nCalEdgePos[2] - m_nCalEdgePos[0];
+    nSprRising = m_nCalEdgePos[3] - m_nCalEdgePos[1];
+    nFirstFalling = m_bCalFirstFalling ? 0 : 1;
+    nSteps = (nSprFalling + nSprRising + 1) / 2;
+    m_nCalSpread = labs(nSprFalling - nSprRising);
+    m_nCalRevTime = (m_nCalEdgeTime[2] - m_nCalEdgeTime[0]) / 1000;
+
+    if (nSteps <= 0 || m_nCalSpread > nSteps / CALIBRATION_SPREAD_DIVIDER) {
+        DBPrintln("Single pass calibration spread too large, falling back to two passes");
+        m_bCalSinglePass = false;
+        m_bisAtHome = (digitalRead(HOME_PIN) == LOW);
+        StartTwoPassCalibrating();
+        return;
+    }
+
+    // only now, CorrectDrift uses the magnet width and edges we rejected would give a bad one
+    m_bCalSinglePass = true;
+    m_nCalMagnetWidth = m_nCalEdgePos[nFirstFalling + 1] - m_nCalEdgePos[nFirstFalling];
+    // the falling edge is home, same as what the two pass calibration measures
+    m_nHomePosEdgePass2 = m_nCalEdgePos[nFirstFalling + 2];
+    m_nHomePosEdgePass1 = m_nHomePosEdgePass2 - nSteps;
+    m_nStepsAtHome = m_nHomePosEdgePass2;
+    m_seekMode = HOMING_FINISH;
+    m_bSetToHomeAzimuth = true;
+    m_bDoStepsPerRotation = true;
+}
+
+void RotatorClass::StartTwoPassCalibrating()
 {
     stepper.setCurrentPosition(0);
     m_bDoStepsPerRotation = false;
@@ -945,6 +1691,16 @@ void RotatorClass::Calibrate()
                 }
                 break;
 
+            case(CALIBRATION_EDGES):
+                if (!stepper.isRunning() && m_nCalEdges == 4)
+                    FinishEdgeCalibration();
+                break;
+
+            case(CALIBRATION_APPROACH):
+                if (!stepper.isRunning())
+                    StartEdgeCalibration();
+                break;
+
             default:
                 break;
         }
@@ -986,9 +1742,11 @@ void RotatorClass::MoveRelative(const long howFar)
 void RotatorClass::ButtonCheck()
 {
     if (digitalRead(BUTTON_CW) == LOW) {
+        ClearWaypoints();
         MoveRelative(160000000L);
     }
     else if (digitalRead(BUTTON_CCW) == LOW)  {
+        ClearWaypoints();
         MoveRelative(-160000000L);
     }
     else {
@@ -1008,32 +1766,64 @@ void RotatorClass::Run()
 {
     long stepsFromZero;
     long position;
-    float azimuthDelta;
 
-    if (m_periodicReadingTimer.elapsed() >= m_nNextPeriodicReadingLapse) {
-        m_nVolts = ReadVolts();
-        m_periodicReadingTimer.reset();
+    // the stepper interrupt isn't there to do it
+    if (!m_bMotorTimerRunning) {
+        m_bHomePinLow = (digitalRead(HOME_PIN) == LOW);
+        PublishMotionState();
     }
 
+    if (m_nWaypointStatus == WAYPOINTS_RUNNING)
+        RunWaypoints();
+
     if (m_seekMode > HOMING_HOME)
         Calibrate();
 
-    if (stepper.isRunning()) {
+    if (m_bDriftEdgePending) {
+        CorrectDrift(m_nDriftEdgePos, m_nDriftEdgeDirection);
+        m_bDriftEdgePending = false;
+    }
+
+    if (stepper.isRunning())
         m_bWasRunning = true;
-        if (m_seekMode == HOMING_HOME && m_HomeFound) { // We're looking for home and found it
-            Stop();
-            m_bSetToHomeAzimuth = true; // Need to set home az but not until rotator is stopped;
-            m_seekMode = HOMING_FINISH;
-            return;
+
+    // the slow seek can be stopped already by the time we get here
+    if ((m_seekMode == HOMING_HOME || m_seekMode == HOMING_SLOW_SEEK) && m_HomeFound) { // We're looking for home and found it
+        if (m_seekMode == HOMING_SLOW_SEEK) {
+            // how far from where we thought it was did we find the edge
+            m_nEdgeError = WrapPosition(m_nStepsAtHome - GetAzimuthToPosition(m_Config.homeAzimuth));
+            if (m_nEdgeError > m_Config.stepsPerRotation / 2)
+                m_nEdgeError -= m_Config.stepsPerRotation;
+            if (!m_nEdgeCaptures || m_nEdgeError < m_nEdgeErrorMin)
+                m_nEdgeErrorMin = m_nEdgeError;
+            if (!m_nEdgeCaptures || m_nEdgeError > m_nEdgeErrorMax)
+                m_nEdgeErrorMax = m_nEdgeError;
+            m_nEdgeCaptures++;
         }
+        Stop();
+        m_bSetToHomeAzimuth = true; // Need to set home az but not until rotator is stopped;
+        m_seekMode = HOMING_FINISH;
+        return;
     }
 
     if (stepper.isRunning())
         return;
 
+    if (m_seekMode == HOMING_FAST_APPROACH || m_seekMode == HOMING_BACK_OFF) {
+        ContinueHoming();
+        return;
+    }
+
     if( m_seekMode == HOMING_BACK_HOME) {
-        m_bisAtHome = true; // we're back home and done homing.
+        m_bisAtHome = m_bBackHomeIsHome; // we're back home and done homing.
+        m_bBackHomeIsHome = true;
+        m_bPositionKnown = true;
         m_seekMode = HOMING_NONE;
+        if (m_bHoming) {
+            m_nHomingTime = m_HomingTimer.elapsed();
+            m_bHoming = false;
+            ResetSlipStats(); // slip is counted from the last homing
+        }
     }
 
     if (m_bDoStepsPerRotation) {
@@ -1041,42 +1831,43 @@ void RotatorClass::Run()
         SetStepsPerRotation(m_nHomePosEdgePass2 - m_nHomePosEdgePass1);
         SaveToEEProm();
         position = stepper.currentPosition();
-        azimuthDelta = (float)(position - m_nHomePosEdgePass2) / m_fStepsPerDegree;
-        SyncPosition(azimuthDelta + m_Config.homeAzimuth);
+        stepper.setCurrentPosition(WrapPosition(position - m_nHomePosEdgePass2 + GetAzimuthToPosition(m_Config.homeAzimuth)));
         m_nStepsAtHome = 0;
     }
 
     if (m_bSetToHomeAzimuth) {
         m_bSetToHomeAzimuth = false;
+        stepper.setMaxSpeed(m_Config.maxSpeed);
         position = stepper.currentPosition();
-        azimuthDelta = (float)(position - m_nStepsAtHome) / m_fStepsPerDegree;
-        SyncPosition(azimuthDelta + m_Config.homeAzimuth);
-        position = stepper.currentPosition();
-        GoToAzimuth(m_Config.homeAzimuth); // moving to home now that we know where we are
+        stepper.setCurrentPosition(WrapPosition(position - m_nStepsAtHome + GetAzimuthToPosition(m_Config.homeAzimuth)));
+        if (m_nWaypointStatus == WAYPOINTS_RUNNING && m_Waypoints[m_nCurrentWaypoint].type == WAYPOINT_HOME &&
+            m_nCurrentWaypoint + 1 < m_nWaypoints && m_Waypoints[m_nCurrentWaypoint + 1].type == WAYPOINT_GOTO) {
+            // go straight to the next waypoint instead of stopping at home first
+            m_nCurrentWaypoint++;
+            m_bBackHomeIsHome = false;
+            GoToAzimuthCentiDeg(m_Waypoints[m_nCurrentWaypoint].value);
+        }
+        else
+            GoToAzimuth(m_Config.homeAzimuth); // moving to home now that we know where we are
         m_seekMode = HOMING_BACK_HOME;
     }
 
     if (m_bWasRunning) {
-        stepsFromZero = GetPosition();
-        if (stepsFromZero < 0) {
-            while (stepsFromZero < 0)
-                stepsFromZero += m_Config.stepsPerRotation;
-
-            stepper.setCurrentPosition(stepsFromZero);
-        }
-
-        if (stepsFromZero > m_Config.stepsPerRotation) {
-            while (stepsFromZero > m_Config.stepsPerRotation)
-                stepsFromZero -= m_Config.stepsPerRotation;
-
-            stepper.setCurrentPosition(stepsFromZero);
+        if (m_nDriftPending && m_seekMode == HOMING_NONE) {
+            stepper.setCurrentPosition(stepper.currentPosition() - m_nDriftPending);
+            m_nDriftPending = 0;
         }
+        stepsFromZero = GetPosition();
+        if (stepsFromZero < 0 || stepsFromZero > m_Config.stepsPerRotation)
+            stepper.setCurrentPosition(WrapPosition(stepsFromZero));
 
         if( m_seekMode == HOMING_NONE) {
             // not moving anymore ..
             m_nMoveDirection = MOVE_NONE;
             EnableMotor(false);
             m_bWasRunning = false;
+            m_bHoming = false;
+            stepper.setMaxSpeed(m_Config.maxSpeed); // in case we were aborted during the slow seek
             // check if we stopped on the home sensor
             if(digitalRead(HOME_PIN) == LOW) {
                 // we're at the home position
@@ -1113,6 +1904,7 @@ void RotatorClass::stopInterrupt()
     DBPrintln("Stopping motor interrupt");
     // stop interrupt timer
     stopTimer(TC1, 0, TC3_IRQn);
+    m_bMotorTimerRunning = false;
 }
 
 void RotatorClass::motorMoveTo(const long newPosition)
@@ -1124,6 +1916,7 @@ void RotatorClass::motorMoveTo(const long newPosition)
     nFreq = m_Config.maxSpeed *3 >20000 ? 20000 : m_Config.maxSpeed*3;
     // start interrupt timer
     // AccelStepper run() is called under a timer interrupt
+    m_bMotorTimerRunning = true;
     startTimer(TC1, 0, TC3_IRQn, nFreq);
 }
 
@@ -1136,6 +1929,7 @@ void RotatorClass::motorMoveRelative(const long howFar)
     nFreq = m_Config.maxSpeed *3 >20000 ? 20000 : m_Config.maxSpeed*3;
     // start interrupt timer
     // AccelStepper run() is called under a timer interrupt
+    m_bMotorTimerRunning = true;
     startTimer(TC1, 0, TC3_IRQn, nFreq);
 }
 
@@ -18,11 +18,15 @@
 #define XBEE_S1
 // #define XBEE_S2C
 
+// if uncommented, XBEE_API_MODE will use the XBee API mode with framed packets, acknowledgement and retries
+// to talk to the shutter instead of the transparent mode. The shutter firmware needs to use the same mode.
+// #define XBEE_API_MODE
+
 #define MAX_TIMEOUT 10
 #define ERR_NO_DATA -1
 #define OK  0
 
-#define VERSION "2.645"
+#define VERSION "2.662"
 
 #define USE_EXT_EEPROM
 #define USE_ETHERNET
@@ -31,6 +35,7 @@
 // include and some defines for ethernet connection
 #include <SPI.h>
 #include <Ethernet.h>
+#include <EthernetUdp.h>
 #include "EtherMac.h"
 #endif
 
@@ -50,21 +55,140 @@ uint32_t uidBuffer[4];  // DUE unique ID
 byte MAC_Address[6];    // Mac address, uses part of the unique ID
 
 #define SERVER_PORT 2323
+// The W5500 has 8 sockets, keep some free for the listening socket, DHCP and UDP telemetry.
+#define MAX_ETH_CLIENTS 4
+// close connections that haven't sent anything in that long (half-dead connections)
+#define ETH_CLIENT_IDLE_TIMEOUT 300000  // 5 minutes
+// the controller session loses control if it's silent for that long
+#define ETH_CONTROLLER_LEASE    60000   // 1 minute
+#define NO_CONTROLLER   -1
+// replies are queued per client and sent with one write per loop iteration,
+// the W5500 sends each write as its own segment so this avoids a flood of tiny packets.
+#define ETH_TX_BUFFER_SIZE  512
+// set to 1 to write each reply as soon as it's ready (lowest latency, one segment per reply).
+// Can be set from the build (-DETH_TX_NODELAY=1) to compare both with Tools/RTI-Load against the board :
+// rti-load -a <controller ip> -c 1 -n 200 for the request/reply latency, add -b for back to back requests.
+#ifndef ETH_TX_NODELAY
+#define ETH_TX_NODELAY      0
+#endif
+// DHCP lease check, no need to poll the W5500 for it every loop
+#define ETH_MAINTAIN_INTERVAL   1000    // 1 second
+
 EthernetServer domeServer(SERVER_PORT);
-EthernetClient domeClient;
+EthernetClient domeClients[MAX_ETH_CLIENTS];
+String networkBuffers[MAX_ETH_CLIENTS];
+StopWatch networkIdleTimers[MAX_ETH_CLIENTS];
+uint8_t txBuffers[MAX_ETH_CLIENTS][ETH_TX_BUFFER_SIZE];
+int txLengths[MAX_ETH_CLIENTS];
+StopWatch EthernetMaintainTimer;
 int nbEthernetClient;
-String networkBuffer;
+// index of the client allowed to move the dome or change settings
+int nControllerClient = NO_CONTROLLER;
+
+// UDP telemetry
+// All values are little endian
+//  0 uint32  magic 'RTIT'
+//  4 uint8   packet version
+//  5 uint8   flags (see TELEMETRY_FLAG_*)
+//  6 uint8   seek mode
+//  7 int8    move direction
+//  8 uint32  sequence number
+// 12 uint32  uptime (ms)
+// 16 int32   azimuth (1/100 degree)
+// 20 int32   position (steps)
+// 24 uint16  rotator volts (1/100 V)
+// 26 uint16  shutter volts (1/100 V)
+// 28 uint8   shutter state (ShutterStates of the shutter firmware, TELEMETRY_SHUTTER_UNKNOWN if we haven't heard from it)
+// 29 uint8   number of TCP clients
+// 30 uint16  average loop time (us)
+// 32 uint16  max loop time (us)
+// 34 uint32  number of loops since last packet
+// 38 uint16  reserved
+#define TELEMETRY_MAGIC         0x54495452
+#define TELEMETRY_VERSION       2
+#define TELEMETRY_PACKET_SIZE   40
+#define TELEMETRY_FLAG_MOVING           0x01
+#define TELEMETRY_FLAG_AT_HOME          0x02
+#define TELEMETRY_FLAG_RAINING          0x04
+#define TELEMETRY_FLAG_SHUTTER_PRESENT  0x08
+#define TELEMETRY_FLAG_SHUTTER_LOW_VOLTS 0x10
+#define TELEMETRY_FLAG_HAS_CONTROLLER   0x20
+#define TELEMETRY_SHUTTER_UNKNOWN       0xFF
+EthernetUDP telemetryUdp;
+TelemetryConfig TelemetrySettings;
+StopWatch TelemetryTimer;
+bool bTelemetryStarted = false;
+uint32_t nTelemetrySeq = 0;
+// loop time stats, reset every time we send a packet
+unsigned long nLastLoopMicros = 0;
+unsigned long nLoopTimeSum = 0;
+unsigned long nLoopTimeMax = 0;
+unsigned long nLoopCount = 0;
 #endif
 
+// command source for ProcessCommand, network clients use their index
+#define CMD_FROM_SERIAL -1
+
 String computerBuffer;
 
+// Binary frames, a client switches to them with B1 and back to ASCII with B0 or by sending an ASCII command.
+//  0 uint8   BIN_FRAME_START
+//  1 uint8   payload length
+//  2 uint8   sequence id, sent back in the reply
+//  3 ...     payload, an ASCII command without the '#' or BIN_STATUS_CMD
+//  n uint16  CRC16 of bytes 1 to n-1, big endian
+// BIN_STATUS_CMD reply, all values are little endian
+//  0 uint8   BIN_STATUS_CMD
+//  1 uint16  azimuth (1/100 degree)
+//  3 int8    move direction
+//  4 uint8   home status
+//  5 uint8   shutter state (ShutterStates of the shutter firmware, BIN_STATUS_SHUTTER_UNKNOWN if we haven't heard from it)
+//  6 uint8   flags (see BIN_STATUS_FLAG_*)
+//  7 uint16  rotator volts (1/100 V)
+#define BIN_FRAME_START     0xA5
+#define BIN_MAX_PAYLOAD     251 // so length, sequence, payload and CRC fit in 255 bytes
+#define BIN_STATUS_CMD      0x01
+#define BIN_STATUS_SIZE     9
+#define BIN_CRC_ERROR       0x15    // reply payload when the CRC of the request doesn't match
+#define BIN_REPLY_TOO_LONG  0x16    // reply payload when the reply doesn't fit in a frame, it's not truncated
+#define BIN_STATUS_FLAG_RAINING             0x01
+#define BIN_STATUS_FLAG_SHUTTER_PRESENT     0x02
+#define BIN_STATUS_FLAG_SHUTTER_LOW_VOLTS   0x04
+#define BIN_STATUS_SHUTTER_UNKNOWN          0xFF
+
+enum BinaryRxStates {BIN_WAIT_START = 0, BIN_WAIT_LENGTH, BIN_WAIT_DATA};
+
+typedef struct BinaryLink {
+    bool        bEnabled;
+    uint8_t     nState;
+    int         nIndex;
+    uint8_t     nSequence;  // of the frame we're answering
+    uint8_t     frame[BIN_MAX_PAYLOAD + 4]; // length, sequence, payload and CRC
+} BinaryLink;
+
+// serial port is index 0, network clients are index + 1
+#ifdef USE_ETHERNET
+BinaryLink binaryLinks[MAX_ETH_CLIENTS + 1];
+#else
+BinaryLink binaryLinks[1];
+#endif
+
 
 #ifndef STANDALONE
 #define XBEE_RESET  8
 #include "RemoteShutterClass.h"
 RemoteShutterClass RemoteShutter;
+#ifdef XBEE_API_MODE
+#include <XBeeAPI.h>    // in Hardware/Firmwares/libraries
+XBeeAPI XBee(Wireless, 0x0001);  // shutter is MY1
+#define WirelessRx XBee
+unsigned long nXBeeBaud = XBEE_API_BAUD;
+#else
+#define WirelessRx Wireless
+#endif
 String wirelessBuffer;
 bool XbeeStarted, sentHello, isConfiguringWireless, gotHelloFromShutter;
+bool gotShutterConfig = false;    // the shutter answered our N with its settings
 int configStep = 0;
 bool isResetingXbee = false;
 int XbeeResets = 0;
@@ -77,17 +201,27 @@ RotatorClass *Rotator = NULL;
 // XBee init AT commands
 ///
 #ifndef STANDALONE
+#ifdef XBEE_API_MODE
+#define XBEE_AT_AP  "ATAP1"
+#define XBEE_AT_BD  "ATBD7"     // 115200
+#else
+#define XBEE_AT_AP  "ATAP0"
+#define XBEE_AT_BD  "ATBD3"     // 9600
+#endif
+
 #if defined(XBEE_S1)
 #define NB_AT_OK  17
 /// ATAC,CE1,ID4242,CH0C,MY0,DH0,DLFFFF,RR6,RN2,PL4,AP0,SM0,BD3,WR,FR,CN
 String ATString[18] = {"ATRE","ATWR","ATAC","ATCE1","","ATCH0C","ATMY0","ATDH0","ATDLFFFF",
-                        "ATRR6","ATRN2","ATPL4","ATAP0","ATSM0","ATBD3","ATWR","ATFR","ATCN"};
+                        "ATRR6","ATRN2","ATPL4",XBEE_AT_AP,"ATSM0",XBEE_AT_BD,"ATWR","ATFR","ATCN"};
+#define XBEE_BD_STEP 14
 #endif
 #if defined(XBEE_S2C)
 #define NB_AT_OK  13
 /// ATAC,CE1,ID4242,DH0,DLFFFF,PL4,AP0,SM0,BD3,WR,FR,CN
 String ATString[18] = {"ATRE","ATWR","ATAC","ATCE1","","ATDH0","ATDLFFFF",
-                        "ATPL4","ATAP0","ATSM0","ATBD3","ATWR","ATFR","ATCN"};
+                        "ATPL4",XBEE_AT_AP,"ATSM0",XBEE_AT_BD,"ATWR","ATFR","ATCN"};
+#define XBEE_BD_STEP 10
 #endif
 
 // index in array above where the command is empty.
@@ -95,6 +229,10 @@ String ATString[18] = {"ATRE","ATWR","ATAC","ATCE1","","ATDH0","ATDLFFFF",
 #define PANID_STEP 4
 
 static const unsigned long pingInterval = 15000; // 15 seconds, can't be changed with command
+static const unsigned long rainHeartbeatInterval = 10000; // remind the shutter it's raining every 10 seconds
+static const unsigned long shutterProbeInterval = 5000; // when the shutter link is down, let one command through every 5 seconds
+
+#define SHUTTER_LINK_DOWN_MISSES  3 // unanswered messages in a row before we stop waiting for the shutter
 
 #define MAX_XBEE_RESET  10
 // Once booting is done and XBee is ready, broadcast a hello message
@@ -105,6 +243,9 @@ volatile  bool SentHello = false;
 // Timer to periodically ping the shutter.
 StopWatch PingTimer;
 StopWatch ShutterWatchdog;
+StopWatch RainHeartbeatTimer;
+StopWatch ShutterProbeTimer;
+int nShutterMissedReplies = 0;
 
 #endif
 
@@ -147,16 +288,31 @@ const char STEPSPER_ROTATOR_CMD         = 't'; // Get/set Steps per rotation
 const char IP_GATEWAY                   = 'u'; // get/set default gateway IP
 const char VERSION_ROTATOR_GET          = 'v'; // Get Firmware Version
 const char IP_DHCP                      = 'w'; // get/set DHCP mode
+const char TELEMETRY_CMD                = 'U'; // get/set UDP telemetry interval,ip,port
                                         //'x' see bellow
 const char REVERSED_ROTATOR_CMD         = 'y'; // Get/Set stepper reversed status
 const char HOMESTATUS_ROTATOR_GET       = 'z'; // Get homed status
 
 const char RAIN_SHUTTER_GET             = 'F'; // Get rain status (from client) or tell shutter it's raining (from Rotator)
+const char FINGERPRINT_GET              = 'A'; // Get version, MAC, config CRC, shutter present and state, azimuth and home status in one go, A1 also switches to binary frames
+const char TAGGED_FRAME                 = '~'; // ~xx<command>, the 2 characters sequence id xx is sent back in front of the reply
+const char BINARY_MODE                  = 'B'; // B1 switch this client to binary frames, B0 back to ASCII
+const char HOMING_DIAG_GET              = 'J'; // Get last homing time (ms), last edge error, min/max edge error (steps), edge captures, two speed homing used,
+                                               // magnet width, edge spread (steps), turn time (ms), single pass used for the last calibration
+const char WAYPOINTS_CMD                = 'W'; // Get waypoint queue status,current,count. Set : segments separated by ',' H home, G<az> goto, S<az> sync, D<ms> wait
+const char SLIP_STATS_CMD               = 'S'; // Get home crossings, last slip, largest slip, total correction (steps), rejected crossings since the last homing. S0 resets them
+const char CONFIG_CMD                   = 'N'; // Get/Set all the settings in one go, see ConfigFields. Set replies NE if any value is invalid, nothing is changed then.
+                                               // Also sent to the shutter with its part of the fields (speed,acceleration,watchdog interval,cutoff)
+const char CONFIG_BLOB_CMD              = 'X'; // Get/Set all the rotator settings as a versioned blob (hex, see ConfigBlob.h). Set replies XE if the blob is refused
+
+// N fields, the shutter ones are optional
+enum ConfigFields { CONFIG_STEPS, CONFIG_ACCELERATION, CONFIG_SPEED, CONFIG_REVERSED, CONFIG_HOMEAZ, CONFIG_PARKAZ, CONFIG_CUTOFF, CONFIG_RAIN_ACTION,
+                    CONFIG_SHUTTER_SPEED, CONFIG_SHUTTER_ACCELERATION, CONFIG_SHUTTER_WATCHDOG, CONFIG_SHUTTER_CUTOFF, CONFIG_ALL_FIELDS };
+#define CONFIG_ROTATOR_FIELDS   CONFIG_SHUTTER_SPEED
 
 #ifndef STANDALONE
 const char INIT_XBEE                    = 'x'; // force a XBee reconfig
 
-// available A B J N S U W X Z
 // Shutter commands
 const char CLOSE_SHUTTER_CMD            = 'C'; // Close shutter
 const char SHUTTER_RESTORE_MOTOR_DEFAULT= 'D'; // Restore default values for motor control.
@@ -175,6 +331,7 @@ const char SPEED_SHUTTER_CMD            = 'R'; // Get/Set step rate (speed)
 const char STEPSPER_SHUTTER_CMD         = 'T'; // Get/Set steps per stroke
 const char VERSION_SHUTTER_GET          = 'V'; // Get version string
 const char REVERSED_SHUTTER_CMD         = 'Y'; // Get/Set stepper reversed status
+const char SHUTTER_CONFIG_BLOB_CMD      = 'Z'; // Get/Set all the shutter settings as a versioned blob, ZE if the shutter refused it or didn't answer
 #endif
 
 // function prototypes
@@ -183,6 +340,8 @@ void checkInterruptTimer();
 void configureEthernet();
 bool initEthernet(bool bUseDHCP, IPAddress ip, IPAddress dns, IPAddress gateway, IPAddress subnet);
 void checkForNewTCPClient();
+void configureTelemetry();
+void sendTelemetry();
 #endif
 void homeIntHandler();
 void rainIntHandler();
@@ -201,12 +360,33 @@ void checkShuterLowVoltage();
 #endif
 void PingShutter();
 #ifdef USE_ETHERNET
-void ReceiveNetwork(EthernetClient);
+void ReceiveNetwork(int);
+void stopTCPClient(int);
+void queueTCPReply(int, const uint8_t *, int);
+void flushTCPReply(int);
+void flushTCPReplies();
+bool isControlCommand(char, bool);
 #endif
 void ReceiveComputer();
-void ProcessCommand();
+void ProcessCommand(int);
+bool ReceiveBinary(int, Stream &);
+void ProcessFrame(int);
+void SendFrame(int, const uint8_t *, int);
+void SendBinaryStatus(int);
+void resetBinaryLink(int);
+String getFingerprint();
+long parseCentiDeg(const String &);
+bool parseWaypoints(const String &);
+char applyConfig(const String &);
+String getConfigString();
+String formatCentiDeg(long);
+void WirelessSend(String);
 void ReceiveWireless();
 void ProcessWireless();
+#ifndef STANDALONE
+bool isShutterCommand(char);
+bool isShutterLinkDown();
+#endif
 
 void setup()
 {
@@ -238,7 +418,11 @@ void setup()
 
     Computer.begin(115200);
 #ifndef STANDALONE
+#ifdef XBEE_API_MODE
+    Wireless.begin(nXBeeBaud);
+#else
     Wireless.begin(9600);
+#endif
     PingTimer.reset();
     XbeeStarted = false;
     sentHello = false;
@@ -249,7 +433,7 @@ void setup()
     Rotator->motorStop();
     Rotator->EnableMotor(false);
     noInterrupts();
-    attachInterrupt(digitalPinToInterrupt(HOME_PIN), homeIntHandler, FALLING);
+    attachInterrupt(digitalPinToInterrupt(HOME_PIN), homeIntHandler, CHANGE); // calibration uses both edges
     attachInterrupt(digitalPinToInterrupt(RAIN_SENSOR_PIN), rainIntHandler, CHANGE);
     attachInterrupt(digitalPinToInterrupt(BUTTON_CW), buttonHandler, CHANGE);
     attachInterrupt(digitalPinToInterrupt(BUTTON_CCW), buttonHandler, CHANGE);
@@ -262,10 +446,22 @@ void setup()
 
 void loop()
 {
+#ifdef USE_ETHERNET
+    unsigned long nLoopMicros = micros();
+    if(nLastLoopMicros) {
+        nLoopTimeSum += nLoopMicros - nLastLoopMicros;
+        if((nLoopMicros - nLastLoopMicros) > nLoopTimeMax)
+            nLoopTimeMax = nLoopMicros - nLastLoopMicros;
+        nLoopCount++;
+    }
+    nLastLoopMicros = nLoopMicros;
+#endif
 
 #ifdef USE_ETHERNET
-    if(ethernetPresent)
+    if(ethernetPresent) {
         checkForNewTCPClient();
+        sendTelemetry();
+    }
 #endif
 
 #ifndef STANDALONE
@@ -279,6 +475,10 @@ void loop()
 #endif
     Rotator->Run();
     CheckForCommands();
+#ifdef USE_ETHERNET
+    if(ethernetPresent)
+        flushTCPReplies();
+#endif
     CheckForRain();
     checkInterruptTimer();
 #ifndef STANDALONE
@@ -325,7 +525,7 @@ void checkInterruptTimer()
             detachInterrupt(digitalPinToInterrupt(BUTTON_CW));
             detachInterrupt(digitalPinToInterrupt(BUTTON_CCW));
             // re-attach interrupts
-            attachInterrupt(digitalPinToInterrupt(HOME_PIN), homeIntHandler, FALLING);
+            attachInterrupt(digitalPinToInterrupt(HOME_PIN), homeIntHandler, CHANGE); // calibration uses both edges
             attachInterrupt(digitalPinToInterrupt(RAIN_SENSOR_PIN), rainIntHandler, CHANGE);
             attachInterrupt(digitalPinToInterrupt(BUTTON_CW), buttonHandler, CHANGE);
             attachInterrupt(digitalPinToInterrupt(BUTTON_CCW), buttonHandler, CHANGE);
@@ -389,19 +589,106 @@ bool initEthernet(bool bUseDHCP, IPAddress ip, IPAddress dns, IPAddress gateway,
 
     DBPrintln("Server ready, calling begin()");
     domeServer.begin();
+    bTelemetryStarted = false; // the chip was reset
+    configureTelemetry();
     return true;
 }
 
+void configureTelemetry()
+{
+    Rotator->getTelemetryConfig(TelemetrySettings);
+    if(bTelemetryStarted) {
+        telemetryUdp.stop();
+        bTelemetryStarted = false;
+    }
+    if(!TelemetrySettings.interval)
+        return;
+
+    // multicast destination need the socket to be opened in multicast mode
+    if(TelemetrySettings.ip[0] >= 224 && TelemetrySettings.ip[0] <= 239)
+        bTelemetryStarted = telemetryUdp.beginMulticast(TelemetrySettings.ip, TelemetrySettings.port);
+    else
+        bTelemetryStarted = telemetryUdp.begin(TelemetrySettings.port);
+    TelemetryTimer.reset();
+    DBPrintln("Telemetry started : " + String(bTelemetryStarted));
+}
+
+void sendTelemetry()
+{
+    uint8_t packet[TELEMETRY_PACKET_SIZE];
+    uint8_t nFlags = 0;
+    MotionState motion;
+    int nShutterVolts = 0;
+    int nShutterState = TELEMETRY_SHUTTER_UNKNOWN;
+
+    if(!bTelemetryStarted || TelemetryTimer.elapsed() < TelemetrySettings.interval)
+        return;
+    TelemetryTimer.reset();
+
+    Rotator->GetMotionState(motion);
+    if(motion.direction != MOVE_NONE)
+        nFlags |= TELEMETRY_FLAG_MOVING;
+    if(motion.homeStatus == ATHOME)
+        nFlags |= TELEMETRY_FLAG_AT_HOME;
+    if(bIsRaining)
+        nFlags |= TELEMETRY_FLAG_RAINING;
+    if(nControllerClient != NO_CONTROLLER)
+        nFlags |= TELEMETRY_FLAG_HAS_CONTROLLER;
+#ifndef STANDALONE
+    if(bShutterPresent)
+        nFlags |= TELEMETRY_FLAG_SHUTTER_PRESENT;
+    if(bLowShutterVoltage)
+        nFlags |= TELEMETRY_FLAG_SHUTTER_LOW_VOLTS;
+    nShutterVolts = RemoteShutter.volts.toInt(); // "volts,cutoff"
+    if(bShutterPresent)
+        nShutterState = RemoteShutter.state.toInt();
+#endif
+
+    memset(packet, 0, TELEMETRY_PACKET_SIZE);
+    putLE32(packet, TELEMETRY_MAGIC);
+    packet[4] = TELEMETRY_VERSION;
+    packet[5] = nFlags;
+    packet[6] = motion.seekMode;
+    packet[7] = (uint8_t)(int8_t)motion.direction;
+    putLE32(packet + 8, nTelemetrySeq++);
+    putLE32(packet + 12, millis());
+    putLE32(packet + 16, (uint32_t)motion.azimuth);
+    putLE32(packet + 20, (uint32_t)(int32_t)motion.position);
+    putLE16(packet + 24, Rotator->GetVolts());
+    putLE16(packet + 26, nShutterVolts);
+    packet[28] = nShutterState;
+    packet[29] = nbEthernetClient;
+    putLE16(packet + 30, nLoopCount ? min(nLoopTimeSum / nLoopCount, 65535UL) : 0);
+    putLE16(packet + 32, min(nLoopTimeMax, 65535UL));
+    putLE32(packet + 34, nLoopCount);
+
+    telemetryUdp.beginPacket(TelemetrySettings.ip, TelemetrySettings.port);
+    telemetryUdp.write(packet, TELEMETRY_PACKET_SIZE);
+    telemetryUdp.endPacket();
+
+    nLoopTimeSum = 0;
+    nLoopTimeMax = 0;
+    nLoopCount = 0;
+}
+
 
 void checkForNewTCPClient()
 {
-    if(ServerConfig.bUseDHCP)
+    int i;
+
+    if(ServerConfig.bUseDHCP && EthernetMaintainTimer.elapsed() > ETH_MAINTAIN_INTERVAL) {
         Ethernet.maintain();
+        EthernetMaintainTimer.reset();
+    }
 
     EthernetClient newClient = domeServer.accept();
     if(newClient) {
         DBPrintln("new client");
-        if(nbEthernetClient > 0) { // we only accept 1 client
+        for(i = 0; i < MAX_ETH_CLIENTS; i++) {
+            if(!domeClients[i])
+                break;
+        }
+        if(i == MAX_ETH_CLIENTS) { // all slots are used
             newClient.print("Already in use#");
             newClient.flush();
             newClient.stop();
@@ -409,17 +696,108 @@ void checkForNewTCPClient()
         }
         else {
             nbEthernetClient++;
-            domeClient = newClient;
-            DBPrintln("new client accepted");
+            domeClients[i] = newClient;
+            networkBuffers[i] = "";
+            txLengths[i] = 0;
+            resetBinaryLink(i);
+            networkIdleTimers[i].reset();
+            DBPrintln("new client accepted in slot " + String(i));
             DBPrintln("nb client = " + String(nbEthernetClient));
         }
     }
 
-    if((nbEthernetClient>0) && !domeClient.connected()) {
-        DBPrintln("client disconnected");
-        domeClient.stop();
+    for(i = 0; i < MAX_ETH_CLIENTS; i++) {
+        if(!domeClients[i])
+            continue;
+        if(!domeClients[i].connected()) {
+            DBPrintln("client " + String(i) + " disconnected");
+            stopTCPClient(i);
+        }
+        else if(networkIdleTimers[i].elapsed() > ETH_CLIENT_IDLE_TIMEOUT) {
+            DBPrintln("client " + String(i) + " idle, closing");
+            stopTCPClient(i);
+        }
+    }
+
+    if(nControllerClient != NO_CONTROLLER && networkIdleTimers[nControllerClient].elapsed() > ETH_CONTROLLER_LEASE) {
+        DBPrintln("controller " + String(nControllerClient) + " lease expired");
+        nControllerClient = NO_CONTROLLER;
+    }
+}
+
+void stopTCPClient(int nClient)
+{
+    domeClients[nClient].stop();
+    domeClients[nClient] = EthernetClient();
+    networkBuffers[nClient] = "";
+    txLengths[nClient] = 0;
+    resetBinaryLink(nClient);
+    if(nbEthernetClient > 0)
         nbEthernetClient--;
-        configureEthernet();
+    if(nControllerClient == nClient)
+        nControllerClient = NO_CONTROLLER;
+}
+
+// add a reply to the client's transmit buffer, it goes out on the next flushTCPReplies()
+void queueTCPReply(int nClient, const uint8_t *pData, int nLength)
+{
+    int nChunk;
+
+    while(nLength > 0) {
+        if(txLengths[nClient] == ETH_TX_BUFFER_SIZE)
+            flushTCPReply(nClient);
+        nChunk = min(nLength, ETH_TX_BUFFER_SIZE - txLengths[nClient]);
+        memcpy(txBuffers[nClient] + txLengths[nClient], pData, nChunk);
+        txLengths[nClient] += nChunk;
+        pData += nChunk;
+        nLength -= nChunk;
+    }
+#if ETH_TX_NODELAY
+    flushTCPReply(nClient);
+#endif
+}
+
+// one write per client, we don't wait for the W5500 to send it.
+void flushTCPReply(int nClient)
+{
+    if(!txLengths[nClient])
+        return;
+    if(domeClients[nClient].connected())
+        domeClients[nClient].write(txBuffers[nClient], txLengths[nClient]);
+    txLengths[nClient] = 0;
+}
+
+void flushTCPReplies()
+{
+    for(int i = 0; i < MAX_ETH_CLIENTS; i++)
+        flushTCPReply(i);
+}
+
+// commands that move the dome or the shutter or change a setting.
+// These are only accepted from the controller network client.
+bool isControlCommand(char command, bool hasValue)
+{
+    if(command == BINARY_MODE)
+        return false; // only changes how we talk to this client
+
+    if(hasValue)
+        return true; // all the setters
+
+    switch(command) {
+        case ETH_RECONFIG:
+        case CALIBRATE_ROTATOR_CMD:
+        case RESTORE_MOTOR_DEFAULT:
+        case HOME_ROTATOR_CMD:
+#ifndef STANDALONE
+        case INIT_XBEE:
+        case HELLO_CMD:
+        case CLOSE_SHUTTER_CMD:
+        case OPEN_SHUTTER_CMD:
+        case SHUTTER_RESTORE_MOTOR_DEFAULT:
+#endif
+            return true;
+        default:
+            return false;
     }
 }
 #endif
@@ -466,14 +844,35 @@ void StartWirelessConfig()
     DBPrintln("Xbee configuration started");
     delay(1100); // guard time before and after
     isConfiguringWireless = true;
+#ifdef XBEE_API_MODE
+    XBee.setPassThrough(true);
+#endif
     DBPrintln("Sending +++");
     Wireless.print("+++");
     delay(1100);
+#ifdef XBEE_API_MODE
+    if(Wireless.available() < 1) {
+        // no "OK", the XBee is probably still at the other baud rate
+        nXBeeBaud = (nXBeeBaud == XBEE_API_BAUD) ? XBEE_FALLBACK_BAUD : XBEE_API_BAUD;
+        DBPrintln("No answer, retrying at " + String(nXBeeBaud));
+        Wireless.begin(nXBeeBaud);
+        delay(1100);
+        Wireless.print("+++");
+        delay(1100);
+    }
+#endif
     ShutterWatchdog.reset();
 }
 
 inline void ConfigXBee()
 {
+#ifdef XBEE_API_MODE
+    // the XBee doesn't support the higher baud rate, stay at the default one
+    if(configStep == (XBEE_BD_STEP+1) && wirelessBuffer.startsWith("ERROR")) {
+        DBPrintln(String(XBEE_AT_BD) + " not supported");
+        ATString[XBEE_BD_STEP] = "ATBD3";
+    }
+#endif
 
     DBPrintln("Sending ");
     if ( configStep == PANID_STEP) {
@@ -497,6 +896,13 @@ inline void ConfigXBee()
         while(Wireless.available() > 0) {
             Wireless.read();
         }
+#ifdef XBEE_API_MODE
+        // the new baud rate is applied when we exit command mode.
+        delay(100);
+        nXBeeBaud = ATString[XBEE_BD_STEP].equals("ATBD3") ? XBEE_FALLBACK_BAUD : XBEE_API_BAUD;
+        Wireless.begin(nXBeeBaud);
+        XBee.setPassThrough(false);
+#endif
         SentHello = false;
         gotHelloFromShutter = false;
         isResetingXbee = false;
@@ -516,35 +922,35 @@ void setPANID(String value)
 void SendHello()
 {
     DBPrintln("Sending hello");
-    Wireless.print(String(HELLO_CMD) + "#");
+    WirelessSend(String(HELLO_CMD));
     ReceiveWireless();
     SentHello = true;
 }
 
 void requestShutterData()
 {
-        Wireless.print(String(STATE_SHUTTER_GET) + "#");
+        WirelessSend(String(STATE_SHUTTER_GET));
         ReceiveWireless();
 
-        Wireless.print(String(VERSION_SHUTTER_GET) + "#");
+        WirelessSend(String(VERSION_SHUTTER_GET));
         ReceiveWireless();
 
-        Wireless.print(String(REVERSED_SHUTTER_CMD) + "#");
+        WirelessSend(String(REVERSED_SHUTTER_CMD));
         ReceiveWireless();
 
-        Wireless.print(String(STEPSPER_SHUTTER_CMD) + "#");
+        WirelessSend(String(STEPSPER_SHUTTER_CMD));
         ReceiveWireless();
 
-        Wireless.print(String(SPEED_SHUTTER_CMD) + "#");
+        WirelessSend(String(SPEED_SHUTTER_CMD));
         ReceiveWireless();
 
-        Wireless.print(String(ACCELERATION_SHUTTER_CMD) + "#");
+        WirelessSend(String(ACCELERATION_SHUTTER_CMD));
         ReceiveWireless();
 
-        Wireless.print(String(VOLTS_SHUTTER_CMD) + "#");
+        WirelessSend(String(VOLTS_SHUTTER_CMD));
         ReceiveWireless();
 
-        Wireless.print(String(SHUTTER_PANID_GET) + "#");
+        WirelessSend(String(SHUTTER_PANID_GET));
         ReceiveWireless();
 }
 
@@ -555,37 +961,47 @@ void CheckForCommands()
     ReceiveComputer();
 
 #ifndef STANDALONE
-    if (Wireless.available() > 0) {
+    if (WirelessRx.available() > 0) {
         ReceiveWireless();
     }
 #endif
 #ifdef USE_ETHERNET
-    if(ethernetPresent )
-        ReceiveNetwork(domeClient);
+    if(ethernetPresent ) {
+        for(int i = 0; i < MAX_ETH_CLIENTS; i++) {
+            ReceiveNetwork(i);
+        }
+    }
 #endif
 }
 
 void CheckForRain()
 {
-
-    if(bIsRaining != Rotator->GetRainStatus()) { // was there a state change ?
-        bIsRaining = Rotator->GetRainStatus();
+    bool bRainStatus;
+
+    bRainStatus = Rotator->GetRainStatus(); // debounced
+    if(bIsRaining != bRainStatus) { // was there a state change ?
+        bIsRaining = bRainStatus;
+        // only do the rain action once when it starts raining
+        if (bIsRaining) {
+            if (Rotator->GetRainAction() == HOME)
+                Rotator->StartHoming();
+
+            if (Rotator->GetRainAction() == PARK)
+                Rotator->GoToAzimuth(Rotator->GetParkAzimuth());
+        }
 #ifndef STANDALONE
-        Wireless.print(String(RAIN_SHUTTER_GET) + String(bIsRaining ? "1" : "0") + "#");
-        ReceiveWireless();
+        // the shutter doesn't reply to this one, don't wait for it or count it as a missed reply
+        WirelessSend(String(RAIN_SHUTTER_GET) + String(bIsRaining ? "1" : "0"));
+        RainHeartbeatTimer.reset();
 #endif
     }
-    if (bIsRaining) {
-        if (Rotator->GetRainAction() == HOME)
-            Rotator->StartHoming();
-
-        if (Rotator->GetRainAction() == PARK)
-            Rotator->GoToAzimuth(Rotator->GetParkAzimuth());
-        // keep telling the shutter that it's raining
 #ifndef STANDALONE
-        Wireless.print(String(RAIN_SHUTTER_GET) + String(bIsRaining ? "1" : "0") + "#");
-#endif
+    // keep telling the shutter that it's raining, but not on every loop
+    else if (bIsRaining && RainHeartbeatTimer.elapsed() >= rainHeartbeatInterval) {
+        WirelessSend(String(RAIN_SHUTTER_GET) + "1");
+        RainHeartbeatTimer.reset();
     }
+#endif
 }
 
 #ifndef STANDALONE
@@ -600,7 +1016,7 @@ void checkShuterLowVoltage()
 void PingShutter()
 {
     if(PingTimer.elapsed() >= pingInterval) {
-        Wireless.print(String(SHUTTER_PING) + "#");
+        WirelessSend(String(SHUTTER_PING));
         ReceiveWireless();
         PingTimer.reset();
         }
@@ -608,30 +1024,34 @@ void PingShutter()
 #endif
 
 #ifdef USE_ETHERNET
-void ReceiveNetwork(EthernetClient client)
+void ReceiveNetwork(int nClient)
 {
     char networkCharacter;
 
-    if(!client.connected()) {
+    if(!domeClients[nClient] || !domeClients[nClient].connected()) {
         return;
     }
 
-    if(client.available() < 1)
+    if(domeClients[nClient].available() < 1)
         return; // no data
 
-    while(client.available()>0) {
-        networkCharacter = client.read();
+    if(binaryLinks[nClient + 1].bEnabled && ReceiveBinary(nClient, domeClients[nClient]))
+        return;
+
+    while(domeClients[nClient].available()>0) {
+        networkCharacter = domeClients[nClient].read();
         if (networkCharacter != ERR_NO_DATA) {
             if (networkCharacter == '\r' || networkCharacter == '\n' || networkCharacter == '#') {
                 // End of message
-                if (networkBuffer.length() > 0) {
-                    ProcessCommand(true);
-                    networkBuffer = "";
+                if (networkBuffers[nClient].length() > 0) {
+                    networkIdleTimers[nClient].reset();
+                    ProcessCommand(nClient);
+                    networkBuffers[nClient] = "";
                     return; // we'll read the next command on the next loop.
                 }
             }
             else {
-                networkBuffer += String(networkCharacter);
+                networkBuffers[nClient] += String(networkCharacter);
             }
         }
     }
@@ -645,13 +1065,16 @@ void ReceiveComputer()
     if(Computer.available() < 1)
         return; // no data
 
+    if(binaryLinks[0].bEnabled && ReceiveBinary(CMD_FROM_SERIAL, Computer))
+        return;
+
     while(Computer.available() > 0 ) {
         computerCharacter = Computer.read();
         if (computerCharacter != ERR_NO_DATA) {
             if (computerCharacter == '\r' || computerCharacter == '\n' || computerCharacter == '#') {
                 // End of message
                 if (computerBuffer.length() > 0) {
-                    ProcessCommand(false);
+                    ProcessCommand(CMD_FROM_SERIAL);
                     computerBuffer = "";
                     return; // we'll read the next command on the next loop.
                 }
@@ -663,25 +1086,301 @@ void ReceiveComputer()
     }
 }
 
-void ProcessCommand(bool bFromNetwork)
+// version,MAC,config CRC,shutter present,shutter state
+// the first 3 fields tell the plugin if what it knows about us is still valid
+String getFingerprint()
+{
+    uint16_t nCRC;
+    String sFingerprint;
+
+    nCRC = Rotator->GetConfigCRC();
+    sFingerprint = String(VERSION) + ",";
+#ifdef USE_ETHERNET
+    char macBuffer[20];
+    snprintf(macBuffer,20,"%02x:%02x:%02x:%02x:%02x:%02x",
+            MAC_Address[0],
+            MAC_Address[1],
+            MAC_Address[2],
+            MAC_Address[3],
+            MAC_Address[4],
+            MAC_Address[5]);
+    sFingerprint += String(macBuffer) + ",";
+    if(ServerConfig.bUseDHCP) {
+        // the DHCP server can change our address without the config changing
+        uint8_t ipBuffer[12];
+        IPAddress ipTmp;
+        int i;
+        ipTmp = Ethernet.localIP();
+        for(i = 0; i < 4; i++)
+            ipBuffer[i] = ipTmp[i];
+        ipTmp = Ethernet.subnetMask();
+        for(i = 0; i < 4; i++)
+            ipBuffer[i+4] = ipTmp[i];
+        ipTmp = Ethernet.gatewayIP();
+        for(i = 0; i < 4; i++)
+            ipBuffer[i+8] = ipTmp[i];
+        nCRC = crc16(ipBuffer, sizeof(ipBuffer), nCRC);
+    }
+#else
+    sFingerprint += "0,";
+#endif
+    sFingerprint += String(nCRC, HEX) + ",";
+#ifndef STANDALONE
+    sFingerprint += String(bShutterPresent ? "1" : "0") + "," + RemoteShutter.state;
+#else
+    sFingerprint += "0,0";
+#endif
+    return sFingerprint;
+}
+
+#ifndef STANDALONE
+// commands we forward to the shutter and wait for its reply.
+// Close is not in the list, we always try to close.
+bool isShutterCommand(char command)
+{
+    switch(command) {
+        case SHUTTER_RESTORE_MOTOR_DEFAULT:
+        case ACCELERATION_SHUTTER_CMD:
+        case WATCHDOG_INTERVAL_SET:
+        case VOLTS_SHUTTER_CMD:
+        case SHUTTER_PING:
+        case STATE_SHUTTER_GET:
+        case OPEN_SHUTTER_CMD:
+        case SHUTTER_PANID_GET:
+        case SPEED_SHUTTER_CMD:
+        case STEPSPER_SHUTTER_CMD:
+        case VERSION_SHUTTER_GET:
+        case REVERSED_SHUTTER_CMD:
+        case SHUTTER_CONFIG_BLOB_CMD:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isShutterLinkDown()
+{
+    return nShutterMissedReplies >= SHUTTER_LINK_DOWN_MISSES;
+}
+
+// answer shutter status queries from the values we already have
+// instead of asking the shutter again.
+bool getCachedShutterReply(char command, String &sReply)
+{
+    switch(command) {
+        case ACCELERATION_SHUTTER_CMD:
+            sReply = String(ACCELERATION_SHUTTER_CMD) + RemoteShutter.acceleration;
+            break;
+        case SPEED_SHUTTER_CMD:
+            sReply = String(SPEED_SHUTTER_CMD) + RemoteShutter.speed;
+            break;
+        case REVERSED_SHUTTER_CMD:
+            sReply = String(REVERSED_SHUTTER_CMD) + RemoteShutter.reversed;
+            break;
+        case STATE_SHUTTER_GET:
+            sReply = String(STATE_SHUTTER_GET) + RemoteShutter.state;
+            break;
+        case STEPSPER_SHUTTER_CMD:
+            sReply = String(STEPSPER_SHUTTER_CMD) + RemoteShutter.stepsPerStroke;
+            break;
+        case VERSION_SHUTTER_GET:
+            sReply = String(VERSION_SHUTTER_GET) + RemoteShutter.version;
+            break;
+        case VOLTS_SHUTTER_CMD:
+            sReply = String(VOLTS_SHUTTER_CMD) + RemoteShutter.volts;
+            break;
+        case WATCHDOG_INTERVAL_SET:
+            sReply = String(WATCHDOG_INTERVAL_SET) + RemoteShutter.watchdogInterval;
+            break;
+        case SHUTTER_PANID_GET:
+            sReply = String(SHUTTER_PANID_GET) + RemoteShutter.panid;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+#endif
+
+// H,G<az>,S<az>,D<ms> segments separated by ','
+bool parseWaypoints(const String &sValue)
+{
+    int nStart = 0;
+    int nEnd;
+    long nTmp = 0;
+    int nType;
+    String sSegment;
+
+    while(nStart < (int)sValue.length()) {
+        nEnd = sValue.indexOf(',', nStart);
+        if(nEnd < 0)
+            nEnd = sValue.length();
+        sSegment = sValue.substring(nStart, nEnd);
+        nStart = nEnd + 1;
+        if(!sSegment.length())
+            return false;
+
+        switch(sSegment.charAt(0)) {
+            case 'H':
+                nType = WAYPOINT_HOME;
+                break;
+            case 'G':
+                nType = WAYPOINT_GOTO;
+                break;
+            case 'S':
+                nType = WAYPOINT_SYNC;
+                break;
+            case 'D':
+                nType = WAYPOINT_WAIT;
+                break;
+            default:
+                return false;
+        }
+        if(nType != WAYPOINT_HOME && sSegment.length() < 2)
+            return false;
+        if(nType == WAYPOINT_GOTO || nType == WAYPOINT_SYNC) {
+            nTmp = parseCentiDeg(sSegment.substring(1));
+            if ((nTmp < 0) || (nTmp > CENTIDEG_PER_TURN))
+                return false;
+        }
+        else if(nType == WAYPOINT_WAIT) {
+            nTmp = sSegment.substring(1).toInt();
+            if(nTmp < 0)
+                return false;
+        }
+        if(!Rotator->AddWaypoint(nType, nTmp))
+            return false;
+    }
+    return true;
+}
+
+// all the values are checked before anything is applied, the shutter gets its part in a single message
+// and the rotator config is only saved once the shutter took it.
+// Returns 0 when applied, 'E' if the values or the shutter refused them, 'U' if the shutter link is down.
+char applyConfig(const String &sValue)
+{
+    long nFields[CONFIG_ALL_FIELDS];
+    int nCount = 0;
+    int nStart = 0;
+    int nEnd;
+    String sField;
+
+    while(nStart < (int)sValue.length()) {
+        if(nCount == CONFIG_ALL_FIELDS)
+            return 'E';
+        nEnd = sValue.indexOf(',', nStart);
+        if(nEnd < 0)
+            nEnd = sValue.length();
+        sField = sValue.substring(nStart, nEnd);
+        nStart = nEnd + 1;
+        if(!sField.length())
+            return 'E';
+        if(nCount == CONFIG_HOMEAZ || nCount == CONFIG_PARKAZ)
+            nFields[nCount++] = parseCentiDeg(sField);
+        else
+            nFields[nCount++] = sField.toInt();
+    }
+
+    if(nCount != CONFIG_ROTATOR_FIELDS && nCount != CONFIG_ALL_FIELDS)
+        return 'E';
+    if(nFields[CONFIG_STEPS] <= 0 || nFields[CONFIG_ACCELERATION] <= 0 || nFields[CONFIG_SPEED] <= 0)
+        return 'E';
+    if(nFields[CONFIG_REVERSED] < 0 || nFields[CONFIG_REVERSED] > 1)
+        return 'E';
+    if(nFields[CONFIG_HOMEAZ] < 0 || nFields[CONFIG_HOMEAZ] >= CENTIDEG_PER_TURN)
+        return 'E';
+    if(nFields[CONFIG_PARKAZ] < 0 || nFields[CONFIG_PARKAZ] >= CENTIDEG_PER_TURN)
+        return 'E';
+    if(nFields[CONFIG_CUTOFF] < 0 || nFields[CONFIG_RAIN_ACTION] < DO_NOTHING || nFields[CONFIG_RAIN_ACTION] > PARK)
+        return 'E';
+    if(nCount == CONFIG_ALL_FIELDS) {
+        if(nFields[CONFIG_SHUTTER_SPEED] <= 0 || nFields[CONFIG_SHUTTER_ACCELERATION] <= 0)
+            return 'E';
+        if(nFields[CONFIG_SHUTTER_WATCHDOG] < 0 || nFields[CONFIG_SHUTTER_CUTOFF] < 0)
+            return 'E';
+    }
+
+#ifndef STANDALONE
+    // the shutter keeps its values if it doesn't answer, so do we, the cache is updated from its reply.
+    if(nCount == CONFIG_ALL_FIELDS) {
+        if(isShutterLinkDown())
+            return 'U';
+        gotShutterConfig = false;
+        WirelessSend(String(CONFIG_CMD) + String(nFields[CONFIG_SHUTTER_SPEED]) + "," + String(nFields[CONFIG_SHUTTER_ACCELERATION]) + ","
+                    + String(nFields[CONFIG_SHUTTER_WATCHDOG]) + "," + String(nFields[CONFIG_SHUTTER_CUTOFF]));
+        ReceiveWireless();
+        // something else from the shutter might have been in front of the reply
+        while(!gotShutterConfig && WirelessRx.available() > 0)
+            ReceiveWireless();
+        if(!gotShutterConfig)
+            return isShutterLinkDown() ? 'U' : 'E';
+    }
+#endif
+
+    Rotator->BeginConfigUpdate();
+    Rotator->SetStepsPerRotation(nFields[CONFIG_STEPS]);
+    Rotator->SetAcceleration(nFields[CONFIG_ACCELERATION]);
+    Rotator->SetMaxSpeed(nFields[CONFIG_SPEED]);
+    Rotator->SetReversed(nFields[CONFIG_REVERSED] == 1);
+    Rotator->SetHomeAzimuth(nFields[CONFIG_HOMEAZ] / 100.0);
+    Rotator->SetParkAzimuth(nFields[CONFIG_PARKAZ] / 100.0);
+    Rotator->SetLowVoltageCutoff(nFields[CONFIG_CUTOFF]);
+    Rotator->SetRainAction(nFields[CONFIG_RAIN_ACTION]);
+    Rotator->EndConfigUpdate();
+    return 0;
+}
+
+// same fields as applyConfig, the shutter ones are only there if it's present
+String getConfigString()
+{
+    String sConfig;
+
+    sConfig = String(Rotator->GetStepsPerRotation()) + "," + String(Rotator->GetAcceleration()) + "," + String(Rotator->GetMaxSpeed()) + ","
+            + String(Rotator->GetReversed() ? "1" : "0") + "," + String(Rotator->GetHomeAzimuth()) + "," + String(Rotator->GetParkAzimuth()) + ","
+            + String(Rotator->GetLowVoltageCutoff()) + "," + String(Rotator->GetRainAction());
+#ifndef STANDALONE
+    if(bShutterPresent)
+        sConfig += "," + RemoteShutter.speed + "," + RemoteShutter.acceleration + "," + RemoteShutter.watchdogInterval + ","
+                 + RemoteShutter.volts.substring(RemoteShutter.volts.indexOf(',') + 1);
+#endif
+    return sConfig;
+}
+
+// AzimuthMath.h does the parsing so it can be tested on the host
+long parseCentiDeg(const String &sValue)
+{
+    return parseCentiDeg(sValue.c_str());
+}
+
+// same format as String(float) : "123.45"
+String formatCentiDeg(long centiDeg)
+{
+    return String(centiDeg / 100) + (centiDeg % 100 < 10 ? ".0" : ".") + String(centiDeg % 100);
+}
+
+void ProcessCommand(int nSource)
 {
     float fTmp;
+    long nTmp;
     char command;
     String value;
+    MotionState motion;
 
 #ifndef STANDALONE
     String wirelessMessage;
 #endif
     String serialMessage, sTmpString;
+    String sTag;
     bool hasValue = false;
+    int nBinaryMode = -1;
 
     // Split the buffer into command char and value if present
     // Command character
-    if(bFromNetwork) {
+    if(nSource != CMD_FROM_SERIAL) {
 #ifdef USE_ETHERNET
-        command = networkBuffer.charAt(0);
+        command = networkBuffers[nSource].charAt(0);
         // Payload
-        value = networkBuffer.substring(1);
+        value = networkBuffers[nSource].substring(1);
 #endif
     }
     else {
@@ -689,6 +1388,12 @@ void ProcessCommand(bool bFromNetwork)
         // Payload
         value = computerBuffer.substring(1);
     }
+    // tagged frame, remove the tag and send it back with the reply so the client can match it
+    if (command == TAGGED_FRAME && value.length() >= 3) {
+        sTag = String(TAGGED_FRAME) + value.substring(0, 2);
+        command = value.charAt(2);
+        value = value.substring(3);
+    }
     // payload has data
     if (value.length() > 0)
         hasValue = true;
@@ -701,18 +1406,57 @@ void ProcessCommand(bool bFromNetwork)
     DBPrintln("\nProcessCommand");
     DBPrintln("Command = \"" + String(command) +"\"");
     DBPrintln("Value = \"" + String(value) +"\"");
-    DBPrintln("bFromNetwork = \"" + String(bFromNetwork?"Yes":"No") +"\"");
+    DBPrintln("nSource = \"" + String(nSource) +"\"");
+    DBPrintln("sTag = \"" + sTag +"\"");
+
+#ifdef USE_ETHERNET
+    if(nSource != CMD_FROM_SERIAL && command != ABORT_MOVE_CMD) { // anybody can stop the dome
+        if(isControlCommand(command, hasValue)) {
+            if(nControllerClient == NO_CONTROLLER) {
+                nControllerClient = nSource;
+                DBPrintln("client " + String(nSource) + " is now the controller");
+            }
+            else if(nControllerClient != nSource) {
+                // another client is in control
+                serialMessage = String(command) + "E";
+            }
+        }
+#ifndef STANDALONE
+        else if(nControllerClient != nSource) {
+            getCachedShutterReply(command, serialMessage);
+        }
+#endif
+    }
+
+    // the command was already answered above
+    if (serialMessage.length() > 0)
+        command = 0;
+#endif
+
+#ifndef STANDALONE
+    // don't wait for a shutter that doesn't answer, but let a command through from time to time to see if it's back.
+    if (command && isShutterCommand(command) && isShutterLinkDown()) {
+        if(ShutterProbeTimer.elapsed() < shutterProbeInterval) {
+            serialMessage = String(command) + "U";
+            command = 0;
+        }
+        else
+            ShutterProbeTimer.reset();
+    }
+#endif
 
 
     switch (command) {
         case ABORT_MOVE_CMD:
             sTmpString = String(ABORT_MOVE_CMD);
             serialMessage = sTmpString;
+            Rotator->ClearWaypoints();
             Rotator->Stop();
 #ifndef STANDALONE
             wirelessMessage = sTmpString;
-            Wireless.print(wirelessMessage + "#");
-            ReceiveWireless();
+            WirelessSend(wirelessMessage);
+            if(!isShutterLinkDown())
+                ReceiveWireless();
 #endif
             break;
 
@@ -723,19 +1467,28 @@ void ProcessCommand(bool bFromNetwork)
             serialMessage = String(ACCELERATION_ROTATOR_CMD) + String(Rotator->GetAcceleration());
             break;
 
+        case BINARY_MODE:
+            if (hasValue)
+                nBinaryMode = value.toInt() ? 1 : 0;
+            serialMessage = String(BINARY_MODE) + String(nBinaryMode == -1 ? (binaryLinks[nSource + 1].bEnabled ? 1 : 0) : nBinaryMode);
+            break;
+
         case CALIBRATE_ROTATOR_CMD:
+            Rotator->ClearWaypoints();
             Rotator->StartCalibrating();
             serialMessage = String(CALIBRATE_ROTATOR_CMD);
             break;
 
         case GOTO_ROTATOR_CMD:
             if (hasValue && !bLowShutterVoltage) { // stay at park if shutter voltage is low.
-                fTmp = value.toFloat();
-                if ((fTmp >= 0.0) && (fTmp <= 360.0)) {
-                    Rotator->GoToAzimuth(fTmp);
+                nTmp = parseCentiDeg(value);
+                if ((nTmp >= 0) && (nTmp <= CENTIDEG_PER_TURN)) {
+                    Rotator->ClearWaypoints();
+                    Rotator->GoToAzimuthCentiDeg(nTmp);
                 }
             }
-            serialMessage = String(GOTO_ROTATOR_CMD) + String(Rotator->GetAzimuth());
+            Rotator->GetMotionState(motion);
+            serialMessage = String(GOTO_ROTATOR_CMD) + formatCentiDeg(motion.azimuth);
             break;
 #ifndef STANDALONE
         case HELLO_CMD:
@@ -744,6 +1497,7 @@ void ProcessCommand(bool bFromNetwork)
             break;
 #endif
         case HOME_ROTATOR_CMD:
+            Rotator->ClearWaypoints();
             Rotator->StartHoming();
             serialMessage = String(HOME_ROTATOR_CMD);
             break;
@@ -758,7 +1512,53 @@ void ProcessCommand(bool bFromNetwork)
             break;
 
         case HOMESTATUS_ROTATOR_GET:
-            serialMessage = String(HOMESTATUS_ROTATOR_GET) + String(Rotator->GetHomeStatus());
+            Rotator->GetMotionState(motion);
+            serialMessage = String(HOMESTATUS_ROTATOR_GET) + String(motion.homeStatus);
+            break;
+
+        case HOMING_DIAG_GET:
+            serialMessage = String(HOMING_DIAG_GET) + Rotator->GetHomingDiagnostics();
+            break;
+
+        case WAYPOINTS_CMD:
+            if (hasValue) {
+                Rotator->ClearWaypoints();
+                if(!parseWaypoints(value) || bLowShutterVoltage) { // stay at park if shutter voltage is low.
+                    Rotator->ClearWaypoints();
+                    serialMessage = String(WAYPOINTS_CMD) + "E";
+                    break;
+                }
+                Rotator->StartWaypoints();
+            }
+            serialMessage = String(WAYPOINTS_CMD) + Rotator->GetWaypointStatus();
+            break;
+
+        case CONFIG_BLOB_CMD:
+            if (hasValue) {
+                if(!Rotator->SetConfigBlob(value)) {
+                    serialMessage = String(CONFIG_BLOB_CMD) + "E";
+                    break;
+                }
+#ifdef USE_ETHERNET
+                Rotator->getIpConfig(ServerConfig);
+                configureTelemetry();
+#endif
+            }
+            serialMessage = String(CONFIG_BLOB_CMD) + Rotator->GetConfigBlob();
+            break;
+
+        case CONFIG_CMD:
+            if (hasValue && (nTmp = applyConfig(value))) {
+                serialMessage = String(CONFIG_CMD) + String((char)nTmp);
+                break;
+            }
+            serialMessage = String(CONFIG_CMD) + getConfigString();
+            break;
+
+        case SLIP_STATS_CMD:
+            if (hasValue && value.toInt() == 0)
+                Rotator->ResetSlipStats();
+            serialMessage = String(SLIP_STATS_CMD) + Rotator->GetSlipStats();
             break;
 
         case PARKAZ_ROTATOR_CMD:
@@ -803,7 +1603,8 @@ void ProcessCommand(bool bFromNetwork)
             break;
 
         case SLEW_ROTATOR_GET:
-            serialMessage = String(SLEW_ROTATOR_GET) + String(Rotator->GetDirection());
+            Rotator->GetMotionState(motion);
+            serialMessage = String(SLEW_ROTATOR_GET) + String(motion.direction);
             break;
 
         case STEPSPER_ROTATOR_CMD:
@@ -814,10 +1615,11 @@ void ProcessCommand(bool bFromNetwork)
 
         case SYNC_ROTATOR_CMD:
             if (hasValue) {
-                fTmp = value.toFloat();
-                if (fTmp >= 0 && fTmp < 360) {
-                    Rotator->SyncPosition(fTmp);
-                    serialMessage = String(SYNC_ROTATOR_CMD) + String(Rotator->GetAzimuth());
+                nTmp = parseCentiDeg(value);
+                if (nTmp >= 0 && nTmp < CENTIDEG_PER_TURN) {
+                    Rotator->SyncPositionCentiDeg(nTmp);
+                    Rotator->GetMotionState(motion);
+                    serialMessage = String(SYNC_ROTATOR_CMD) + formatCentiDeg(motion.azimuth);
                 }
             }
             else {
@@ -829,6 +1631,19 @@ void ProcessCommand(bool bFromNetwork)
             serialMessage = String(VERSION_ROTATOR_GET) + VERSION;
             break;
 
+        case FINGERPRINT_GET:
+#ifndef STANDALONE
+            // the hello a client used to send after the fingerprint, so the shutter values in it are fresh
+            if (!isShutterLinkDown())
+                SendHello();
+#endif
+            Rotator->GetMotionState(motion);
+            serialMessage = String(FINGERPRINT_GET) + getFingerprint() + "," + formatCentiDeg(motion.azimuth) + "," + String(motion.homeStatus);
+            // a client that knows us from a previous connection asks for binary frames in the same round trip
+            if (hasValue && value.toInt() == 1)
+                nBinaryMode = 1;
+            break;
+
         case VOLTS_ROTATOR_CMD:
             if (hasValue) {
                 Rotator->SetLowVoltageCutoff(value.toInt());
@@ -843,11 +1658,14 @@ void ProcessCommand(bool bFromNetwork)
         case IS_SHUTTER_PRESENT:
             serialMessage = String(IS_SHUTTER_PRESENT) + String( bShutterPresent? "1" : "0");
             break;
+
+        case 0: // already answered
+            break;
 #ifdef USE_ETHERNET
         case ETH_RECONFIG :
-            if(nbEthernetClient > 0) {
-                domeClient.stop();
-                nbEthernetClient--;
+            for(int i = 0; i < MAX_ETH_CLIENTS; i++) {
+                if(domeClients[i])
+                    stopTCPClient(i);
             }
             configureEthernet();
             serialMessage = String(ETH_RECONFIG)  + String(ethernetPresent?"1":"0");
@@ -897,6 +1715,18 @@ void ProcessCommand(bool bFromNetwork)
             }
             break;
 
+        case TELEMETRY_CMD:
+            if (hasValue) {
+                if(Rotator->setTelemetryConfigString(value))
+                    configureTelemetry();
+                else {
+                    serialMessage = String(TELEMETRY_CMD) + "E";
+                    break;
+                }
+            }
+            serialMessage = String(TELEMETRY_CMD) + Rotator->getTelemetryConfigString();
+            break;
+
         case IP_GATEWAY:
             if (hasValue) {
                 Rotator->setIPGateway(value);
@@ -917,7 +1747,7 @@ void ProcessCommand(bool bFromNetwork)
             XbeeStarted = false;
             configStep = 0;
             serialMessage = sTmpString;
-            Wireless.print(sTmpString + "#");
+            WirelessSend(sTmpString);
             ReceiveWireless();
             DBPrintln("trying to reconfigure radio");
             resetChip(XBEE_RESET);
@@ -928,7 +1758,7 @@ void ProcessCommand(bool bFromNetwork)
             if (hasValue) {
                 RemoteShutter.panid = "0000";
                 wirelessMessage = String(SHUTTER_PANID_GET) + value;
-                Wireless.print(wirelessMessage + "#");
+                WirelessSend(wirelessMessage);
                 setPANID(value); // shutter XBee should be doing the same thing
             }
             serialMessage = sTmpString + String(Rotator->GetPANID());
@@ -936,7 +1766,7 @@ void ProcessCommand(bool bFromNetwork)
 
         case SHUTTER_PANID_GET:
             wirelessMessage = String(SHUTTER_PANID_GET);
-            Wireless.print(wirelessMessage + "#");
+            WirelessSend(wirelessMessage);
             ReceiveWireless();
             serialMessage = String(SHUTTER_PANID_GET) + RemoteShutter.panid ;
             break;
@@ -944,7 +1774,7 @@ void ProcessCommand(bool bFromNetwork)
 
         case SHUTTER_PING:
             wirelessMessage = String(SHUTTER_PING);
-            Wireless.print(wirelessMessage + "#");
+            WirelessSend(wirelessMessage);
             ReceiveWireless();
             serialMessage = String(SHUTTER_PING);
             break;
@@ -958,25 +1788,25 @@ void ProcessCommand(bool bFromNetwork)
             else {
                 wirelessMessage = sTmpString;
             }
-            Wireless.print(wirelessMessage + "#");
+            WirelessSend(wirelessMessage);
             ReceiveWireless();
             serialMessage = sTmpString + RemoteShutter.acceleration;
             break;
 
         case CLOSE_SHUTTER_CMD:
             sTmpString = String(CLOSE_SHUTTER_CMD);
-            Wireless.print(sTmpString+ "#");
+            WirelessSend(sTmpString);
             ReceiveWireless();
             serialMessage = sTmpString;
             break;
 
         case SHUTTER_RESTORE_MOTOR_DEFAULT :
             sTmpString = String(SHUTTER_RESTORE_MOTOR_DEFAULT);
-            Wireless.print(sTmpString+ "#");
+            WirelessSend(sTmpString);
             ReceiveWireless();
-            Wireless.print(String(SPEED_SHUTTER_CMD)+ "#");
+            WirelessSend(String(SPEED_SHUTTER_CMD));
             ReceiveWireless();
-            Wireless.print(String(ACCELERATION_SHUTTER_CMD)+ "#");
+            WirelessSend(String(ACCELERATION_SHUTTER_CMD));
             ReceiveWireless();
             serialMessage = sTmpString;
             break;
@@ -990,14 +1820,14 @@ void ProcessCommand(bool bFromNetwork)
 //          else {
 //              wirelessMessage = sTmpString;
 //          }
-//          Wireless.print(wirelessMessage + "#");
+//          WirelessSend(wirelessMessage);
 //          ReceiveWireless();
 //          serialMessage = sTmpString + RemoteShutter.position;
 //          break;
 
         case OPEN_SHUTTER_CMD:
                 sTmpString = String(OPEN_SHUTTER_CMD);
-                Wireless.print(sTmpString + "#");
+                WirelessSend(sTmpString);
                 ReceiveWireless();
                 serialMessage = sTmpString + RemoteShutter.lowVoltStateOrRaining;
                 break;
@@ -1011,7 +1841,7 @@ void ProcessCommand(bool bFromNetwork)
             else {
                 wirelessMessage = sTmpString;
             }
-            Wireless.print(wirelessMessage + "#");
+            WirelessSend(wirelessMessage);
             ReceiveWireless();
             serialMessage = sTmpString + RemoteShutter.reversed;
             break;
@@ -1025,14 +1855,14 @@ void ProcessCommand(bool bFromNetwork)
             else {
                 wirelessMessage = sTmpString;
             }
-            Wireless.print(wirelessMessage + "#");
+            WirelessSend(wirelessMessage);
             ReceiveWireless();
             serialMessage = sTmpString + RemoteShutter.speed;
             break;
 
         case STATE_SHUTTER_GET:
             sTmpString = String(STATE_SHUTTER_GET);
-            Wireless.print(sTmpString + "#");
+            WirelessSend(sTmpString);
             ReceiveWireless();
             serialMessage = sTmpString + RemoteShutter.state;
             break;
@@ -1046,25 +1876,33 @@ void ProcessCommand(bool bFromNetwork)
             else {
                 wirelessMessage = sTmpString;
             }
-            Wireless.print(wirelessMessage + "#");
+            WirelessSend(wirelessMessage);
             ReceiveWireless();
             serialMessage = sTmpString + RemoteShutter.stepsPerStroke;
             break;
 
         case VERSION_SHUTTER_GET:
             sTmpString = String(VERSION_SHUTTER_GET);
-            Wireless.print(sTmpString + "#");
+            WirelessSend(sTmpString);
             ReceiveWireless();
             serialMessage = sTmpString + RemoteShutter.version;
             break;
 
+        case SHUTTER_CONFIG_BLOB_CMD:
+            sTmpString = String(SHUTTER_CONFIG_BLOB_CMD);
+            RemoteShutter.configBlob = "";
+            WirelessSend(sTmpString + value);
+            ReceiveWireless();
+            serialMessage = sTmpString + (RemoteShutter.configBlob.length() ? RemoteShutter.configBlob : String("E"));
+            break;
+
         case VOLTS_SHUTTER_CMD:
             sTmpString = String(VOLTS_SHUTTER_CMD);
             wirelessMessage = sTmpString;
             if (hasValue)
                 wirelessMessage += String(value);
 
-            Wireless.print(wirelessMessage + "#");
+            WirelessSend(wirelessMessage);
             ReceiveWireless();
             serialMessage = sTmpString + RemoteShutter.volts;
             break;
@@ -1077,7 +1915,7 @@ void ProcessCommand(bool bFromNetwork)
             else {
                 wirelessMessage = sTmpString;
             }
-            Wireless.print(wirelessMessage + "#");
+            WirelessSend(wirelessMessage);
             ReceiveWireless();
             serialMessage = sTmpString + RemoteShutter.watchdogInterval;
             break;
@@ -1090,23 +1928,193 @@ void ProcessCommand(bool bFromNetwork)
 
 
     // Send messages if they aren't empty.
-    if (serialMessage.length() > 0) {
-        if(!bFromNetwork) {
-            Computer.print(serialMessage + "#");
+    if (serialMessage.length() > 0 && binaryLinks[nSource + 1].bEnabled) {
+        SendFrame(nSource, (const uint8_t *)serialMessage.c_str(), serialMessage.length());
+    }
+    else if (serialMessage.length() > 0) {
+        if(nSource == CMD_FROM_SERIAL) {
+            Computer.print(sTag + serialMessage + "#");
             }
 #ifdef USE_ETHERNET
-        else if(domeClient.connected()) {
+        else if(domeClients[nSource].connected()) {
                 DBPrintln("Network serialMessage = " + serialMessage);
-                domeClient.print(serialMessage + "#");
-                domeClient.flush();
+                serialMessage = sTag + serialMessage + "#";
+                queueTCPReply(nSource, (const uint8_t *)serialMessage.c_str(), serialMessage.length());
+        }
+#endif
+    }
+
+    // switch after the reply so it goes out in the mode the client used to ask
+    if (nBinaryMode != -1) {
+        resetBinaryLink(nSource);
+        binaryLinks[nSource + 1].bEnabled = (nBinaryMode == 1);
+    }
+}
+
+void resetBinaryLink(int nSource)
+{
+    binaryLinks[nSource + 1].bEnabled = false;
+    binaryLinks[nSource + 1].nState = BIN_WAIT_START;
+    binaryLinks[nSource + 1].nIndex = 0;
+}
+
+// returns false if the client is back to ASCII, the data is then left for the ASCII parser.
+bool ReceiveBinary(int nSource, Stream &port)
+{
+    BinaryLink &link = binaryLinks[nSource + 1];
+    int nByte;
+
+    while(port.available() > 0) {
+        if(link.nState == BIN_WAIT_START) {
+            if(port.peek() != BIN_FRAME_START) {
+                DBPrintln("source " + String(nSource) + " is back to ASCII");
+                resetBinaryLink(nSource);
+                return false;
+            }
+            port.read();
+            link.nState = BIN_WAIT_LENGTH;
+            continue;
         }
+
+        nByte = port.read();
+        if(nByte < 0)
+            break;
+
+        if(link.nState == BIN_WAIT_LENGTH) {
+            if(nByte == 0 || nByte > BIN_MAX_PAYLOAD) {
+                link.nState = BIN_WAIT_START;
+                continue;
+            }
+            link.frame[0] = nByte;
+            link.nIndex = 1;
+            link.nState = BIN_WAIT_DATA;
+            continue;
+        }
+
+        link.frame[link.nIndex++] = nByte;
+        if(link.nIndex == link.frame[0] + 4) {
+            link.nState = BIN_WAIT_START;
+            ProcessFrame(nSource);
+            return true; // we'll read the next frame on the next loop.
+        }
+    }
+    return true;
+}
+
+void ProcessFrame(int nSource)
+{
+    BinaryLink &link = binaryLinks[nSource + 1];
+    int nLength = link.frame[0];
+    uint16_t nCRC;
+    uint8_t nReply;
+    String sCommand;
+    int i;
+
+    link.nSequence = link.frame[1];
+    nCRC = ((uint16_t)link.frame[nLength + 2] << 8) | link.frame[nLength + 3];
+    if(crc16(link.frame, nLength + 2) != nCRC) {
+        DBPrintln("source " + String(nSource) + " frame CRC error");
+        nReply = BIN_CRC_ERROR;
+        SendFrame(nSource, &nReply, 1);
+        return;
+    }
+
+    if(link.frame[2] == BIN_STATUS_CMD) {
+        SendBinaryStatus(nSource);
+        return;
+    }
+
+    // same commands as in ASCII
+    for(i = 0; i < nLength; i++)
+        sCommand += (char)link.frame[i + 2];
+    if(nSource == CMD_FROM_SERIAL) {
+        computerBuffer = sCommand;
+        ProcessCommand(nSource);
+        computerBuffer = "";
+    }
+#ifdef USE_ETHERNET
+    else {
+        networkBuffers[nSource] = sCommand;
+        networkIdleTimers[nSource].reset();
+        ProcessCommand(nSource);
+        networkBuffers[nSource] = "";
+    }
+#endif
+}
+
+void SendFrame(int nSource, const uint8_t *payload, int nLength)
+{
+    uint8_t frame[BIN_MAX_PAYLOAD + 5];
+    uint8_t nReply;
+    uint16_t nCRC;
+
+    if(nLength > BIN_MAX_PAYLOAD) {
+        DBPrintln("source " + String(nSource) + " reply too long for a frame : " + String(nLength));
+        nReply = BIN_REPLY_TOO_LONG;
+        payload = &nReply;
+        nLength = 1;
+    }
+
+    frame[0] = BIN_FRAME_START;
+    frame[1] = nLength;
+    frame[2] = binaryLinks[nSource + 1].nSequence;
+    memcpy(frame + 3, payload, nLength);
+    nCRC = crc16(frame + 1, nLength + 2);
+    frame[nLength + 3] = nCRC >> 8;
+    frame[nLength + 4] = nCRC & 0xFF;
+
+    if(nSource == CMD_FROM_SERIAL) {
+        Computer.write(frame, nLength + 5);
+    }
+#ifdef USE_ETHERNET
+    else if(domeClients[nSource].connected()) {
+        queueTCPReply(nSource, frame, nLength + 5);
+    }
 #endif
+}
+
+// everything the plugin polls in one reply, no float to format or parse
+void SendBinaryStatus(int nSource)
+{
+    uint8_t payload[BIN_STATUS_SIZE];
+    uint8_t nFlags = 0;
+    uint8_t nShutterState = BIN_STATUS_SHUTTER_UNKNOWN;
+    MotionState motion;
+
+    if(bIsRaining)
+        nFlags |= BIN_STATUS_FLAG_RAINING;
+#ifndef STANDALONE
+    if(bShutterPresent) {
+        nFlags |= BIN_STATUS_FLAG_SHUTTER_PRESENT;
+        nShutterState = RemoteShutter.state.toInt();
     }
+    if(bLowShutterVoltage)
+        nFlags |= BIN_STATUS_FLAG_SHUTTER_LOW_VOLTS;
+#endif
+
+    payload[0] = BIN_STATUS_CMD;
+    Rotator->GetMotionState(motion);
+    putLE16(payload + 1, (uint16_t)motion.azimuth);
+    payload[3] = (uint8_t)(int8_t)motion.direction;
+    payload[4] = motion.homeStatus;
+    payload[5] = nShutterState;
+    payload[6] = nFlags;
+    putLE16(payload + 7, Rotator->GetVolts());
+    SendFrame(nSource, payload, BIN_STATUS_SIZE);
 }
 
 
 #ifndef STANDALONE
 
+void WirelessSend(String sMessage)
+{
+#ifdef XBEE_API_MODE
+    XBee.send(sMessage + "#", bIsRaining ? XBEE_STATUS_RAINING : 0);
+#else
+    Wireless.print(sMessage + "#");
+#endif
+}
+
 void ReceiveWireless()
 {
     int timeout = 0;
@@ -1138,20 +2146,29 @@ void ReceiveWireless()
         return;
     }
 
+#ifdef XBEE_API_MODE
+    // the XBee told us the last message was not delivered, no point waiting for a reply
+    if(WirelessRx.available() < 1 && !XBee.lastSendDelivered()) {
+        nShutterMissedReplies++;
+        return;
+    }
+#endif
+
     // wait for response
     timeout = 0;
-    while(Wireless.available() < 1) {
+    while(WirelessRx.available() < 1) {
         delay(5);   // give time to the shutter to reply
         timeout++;
         if(timeout >= MAX_TIMEOUT) {
+            nShutterMissedReplies++;
             return;
             }
     }
 
     // read the response
     timeout = 0;
-    while(Wireless.available() > 0) {
-        wirelessCharacter = Wireless.read();
+    while(WirelessRx.available() > 0) {
+        wirelessCharacter = WirelessRx.read();
         if (wirelessCharacter != ERR_NO_DATA) {
             if ( wirelessCharacter == '#') {
                 // End of message
@@ -1191,6 +2208,21 @@ void ProcessWireless()
     ShutterWatchdog.reset();
     bShutterPresent = true;
     XbeeResets = 0;
+    nShutterMissedReplies = 0;
+
+#ifdef XBEE_API_MODE
+    uint8_t nShutterStatus;
+    // every frame from the shutter carries its state and battery/rain status
+    if(XBee.getRemoteStatus(nShutterStatus)) {
+        RemoteShutter.state = String(nShutterStatus & XBEE_STATUS_STATE_MASK);
+        if(nShutterStatus & XBEE_STATUS_LOW_VOLTS)
+            RemoteShutter.lowVoltStateOrRaining = "L";
+        else if(nShutterStatus & XBEE_STATUS_RAINING)
+            RemoteShutter.lowVoltStateOrRaining = "R";
+        else
+            RemoteShutter.lowVoltStateOrRaining = "";
+    }
+#endif
 
     switch (command) {
         case ACCELERATION_SHUTTER_CMD:
@@ -1209,7 +2241,7 @@ void ProcessWireless()
             break;
 
         case RAIN_SHUTTER_GET:
-            Wireless.print(String(RAIN_SHUTTER_GET) + String(bIsRaining ? "1" : "0") + "#");
+            WirelessSend(String(RAIN_SHUTTER_GET) + String(bIsRaining ? "1" : "0"));
             break;
 
         case REVERSED_SHUTTER_CMD:
@@ -1250,6 +2282,32 @@ void ProcessWireless()
                 RemoteShutter.watchdogInterval = value;
             break;
 
+        case SHUTTER_CONFIG_BLOB_CMD:
+            if (hasValue)
+                RemoteShutter.configBlob = value;
+            break;
+
+        case CONFIG_CMD: // speed,acceleration,watchdog interval,volts,cutoff
+            if (hasValue) {
+                String sFields[3];
+                int i, nEnd;
+                for(i = 0; i < 3; i++) {
+                    nEnd = value.indexOf(',');
+                    if(nEnd < 0)
+                        break;
+                    sFields[i] = value.substring(0, nEnd);
+                    value = value.substring(nEnd + 1);
+                }
+                if(i == 3) {
+                    RemoteShutter.speed = sFields[0];
+                    RemoteShutter.acceleration = sFields[1];
+                    RemoteShutter.watchdogInterval = sFields[2];
+                    RemoteShutter.volts = value; // volts,cutoff like the K reply
+                    gotShutterConfig = true;
+                }
+            }
+            break;
+
         case SHUTTER_PING:
             bShutterPresent = true;
             if (hasValue)
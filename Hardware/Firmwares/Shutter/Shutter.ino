@@ -13,6 +13,10 @@
 #define XBEE_S1
 // #define XBEE_S2C
 
+// if uncommented, XBEE_API_MODE will use the XBee API mode with framed packets, acknowledgement and retries
+// to talk to the rotator instead of the transparent mode. The rotator firmware needs to use the same mode.
+// #define XBEE_API_MODE
+
 #define DebugPort Serial    // programming port
 #define Wireless Serial1    // XBEE
 
@@ -21,6 +25,15 @@
 
 #include "ShutterClass.h"
 
+#ifdef XBEE_API_MODE
+#include <XBeeAPI.h>    // in Hardware/Firmwares/libraries
+XBeeAPI XBee(Wireless, 0x0000);  // rotator is MY0
+#define WirelessRx XBee
+unsigned long nXBeeBaud = XBEE_API_BAUD;
+#else
+#define WirelessRx Wireless
+#endif
+
 #ifdef DEBUG
 String serialBuffer;
 #endif
@@ -29,9 +42,9 @@ String wirelessBuffer;
 StopWatch ResetInterruptWatchdog;
 static const unsigned long resetInterruptInterval = 43200000; // 12 hours
 
-const String version = "2.645";
+const String version = "2.651";
 
-// available A B J N S U W X Z
+// available A B J S U W X
 const char ABORT_CMD				= 'a';
 const char CLOSE_SHUTTER_CMD		= 'C'; // Close shutter
 const char RESTORE_MOTOR_DEFAULT    = 'D'; // restore default values for motor controll.
@@ -43,6 +56,7 @@ const char WATCHDOG_INTERVAL_SET	= 'I'; // Tell us how long between checks in se
 const char VOLTS_SHUTTER_CMD		= 'K'; // Get volts and get/set cutoff
 const char SHUTTER_PING				= 'L'; // use to reset watchdong timer.
 const char STATE_SHUTTER_GET		= 'M'; // Get shutter state
+const char CONFIG_SHUTTER_CMD		= 'N'; // Get/Set speed,acceleration,watchdog interval,cutoff volts in one go
 const char OPEN_SHUTTER_CMD			= 'O'; // Open the shutter
 const char POSITION_SHUTTER_GET		= 'P'; // Get step position
 const char PANID_GET                = 'Q'; // get and set the XBEE PAN ID
@@ -51,20 +65,31 @@ const char STEPSPER_SHUTTER_CMD		= 'T'; // Get/Set steps per stroke
 const char VERSION_SHUTTER_GET		= 'V'; // Get version string
 const char INIT_XBEE				= 'x'; // force a ConfigXBee
 const char REVERSED_SHUTTER_CMD		= 'Y'; // Get/Set stepper reversed status
+const char CONFIG_BLOB_CMD			= 'Z'; // Get/Set all the settings as a versioned blob (hex, see ConfigBlob.h), ZE if it's refused
+
 
+#ifdef XBEE_API_MODE
+#define XBEE_AT_AP  "ATAP1"
+#define XBEE_AT_BD  "ATBD7"     // 115200
+#else
+#define XBEE_AT_AP  "ATAP0"
+#define XBEE_AT_BD  "ATBD3"     // 9600
+#endif
 
 #if defined(XBEE_S1)
 #define NB_AT_OK  17
 // ATAC,CE0,ID4242,CH0C,MY1,DH0,DL0,RR6,RN2,PL4,AP0,SM0,BD3,WR,FR,CN
 String ATString[18] = {"ATRE","ATWR","ATAC","ATCE0","","ATCH0C","ATMY1","ATDH0","ATDL0",
-                        "ATRR6","ATRN2","ATPL4","ATAP0","ATSM0","ATBD3","ATWR","ATFR","ATCN"};
+                        "ATRR6","ATRN2","ATPL4",XBEE_AT_AP,"ATSM0",XBEE_AT_BD,"ATWR","ATFR","ATCN"};
+#define XBEE_BD_STEP 14
 #endif
 
 #if defined(XBEE_S2C)
 #define NB_AT_OK  14
 /// ATAC,CE1,ID4242,DH0,DLFFFF,PL4,AP0,SM0,BD3,WR,FR,CN
 String ATString[18] = {"ATRE","ATWR","ATAC","ATCE0","","ATDH0","ATDL0","ATJV1",
-                        "ATPL4","ATAP0","ATSM0","ATBD3","ATWR","ATFR","ATCN"};
+                        "ATPL4",XBEE_AT_AP,"ATSM0",XBEE_AT_BD,"ATWR","ATFR","ATCN"};
+#define XBEE_BD_STEP 11
 #endif
 
 
@@ -92,7 +117,11 @@ void setup()
 #ifdef DEBUG
 	DebugPort.begin(115200);
 #endif
+#ifdef XBEE_API_MODE
+	Wireless.begin(nXBeeBaud);
+#else
 	Wireless.begin(9600);
+#endif
     XbeeStarted = false;
 	XbeeResets = 0;
 	isConfiguringWireless = false;
@@ -124,7 +153,7 @@ void loop()
     }
 #endif
 
-	if (Wireless.available() > 0)
+	if (WirelessRx.available() > 0)
 		ReceiveWireless();
 
 	if (!XbeeStarted) {
@@ -213,14 +242,35 @@ void StartWirelessConfig()
     DBPrintln("Xbee configuration started");
 	delay(1100); // guard time before and after
 	isConfiguringWireless = true;
+#ifdef XBEE_API_MODE
+	XBee.setPassThrough(true);
+#endif
 	DBPrintln("Sending +++");
 	Wireless.print("+++");
 	delay(1100);
+#ifdef XBEE_API_MODE
+	if(Wireless.available() < 1) {
+		// no "OK", the XBee is probably still at the other baud rate
+		nXBeeBaud = (nXBeeBaud == XBEE_API_BAUD) ? XBEE_FALLBACK_BAUD : XBEE_API_BAUD;
+		DBPrintln("No answer, retrying at " + String(nXBeeBaud));
+		Wireless.begin(nXBeeBaud);
+		delay(1100);
+		Wireless.print("+++");
+		delay(1100);
+	}
+#endif
 	watchdogTimer.reset();
 }
 
 inline void ConfigXBee(String result)
 {
+#ifdef XBEE_API_MODE
+    // the XBee doesn't support the higher baud rate, stay at the default one
+    if(configStep == (XBEE_BD_STEP+1) && result.startsWith("ERROR")) {
+        DBPrintln(String(XBEE_AT_BD) + " not supported");
+        ATString[XBEE_BD_STEP] = "ATBD3";
+    }
+#endif
     DBPrint("Sending : ");
     if ( configStep == PANID_STEP) {
         String ATCmd = "ATID" + String(Shutter->GetPANID());
@@ -244,6 +294,13 @@ inline void ConfigXBee(String result)
 		while(Wireless.available() > 0) {
 			Wireless.read();
 		}
+#ifdef XBEE_API_MODE
+		// the new baud rate is applied when we exit command mode.
+		delay(100);
+		nXBeeBaud = ATString[XBEE_BD_STEP].equals("ATBD3") ? XBEE_FALLBACK_BAUD : XBEE_API_BAUD;
+		Wireless.begin(nXBeeBaud);
+		XBee.setPassThrough(false);
+#endif
 	}
     delay(100);
 }
@@ -273,12 +330,12 @@ void PingRotator()
         wirelessMessage += "L"; // low voltage detected
     }
 
-    Wireless.print(wirelessMessage + "#");
+    WirelessSend(wirelessMessage);
     // ask if it's raining
-    Wireless.print( String(RAIN_ROTATOR_GET) + "#");
+    WirelessSend(String(RAIN_ROTATOR_GET));
 
     // say hello :)
-    Wireless.print( String(HELLO_CMD) + "#");
+    WirelessSend(String(HELLO_CMD));
     needFirstPing = false;
 }
 
@@ -308,12 +365,29 @@ void ReceiveSerial()
 }
 #endif
 
+void WirelessSend(String sMessage)
+{
+#ifdef XBEE_API_MODE
+    uint8_t nStatus;
+
+    // let the rotator know our state with every message
+    nStatus = Shutter->GetState() & XBEE_STATUS_STATE_MASK;
+    if (Shutter->GetVoltsAreLow())
+        nStatus |= XBEE_STATUS_LOW_VOLTS;
+    if (isRaining)
+        nStatus |= XBEE_STATUS_RAINING;
+    XBee.send(sMessage + "#", nStatus);
+#else
+    Wireless.print(sMessage + "#");
+#endif
+}
+
 void ReceiveWireless()
 {
 	char character;
 	// read as much as possible in one call to ReceiveWireless()
-	while(Wireless.available() > 0) {
-		character = Wireless.read();
+	while(WirelessRx.available() > 0) {
+		character = WirelessRx.read();
 		if (character != ERR_NO_DATA) {
 			watchdogTimer.reset(); // communication are working
 			needFirstPing = false; // if we're getting messages from the rotator we don't need to ping
@@ -336,6 +410,40 @@ void ReceiveWireless()
 	} // end while
 }
 
+// speed,acceleration,watchdog interval (ms),cutoff volts (1/100 V)
+// all values are checked before we change anything and the config is saved once.
+bool ApplyConfig(String value)
+{
+	long nFields[4];
+	int nCount = 0;
+	int nStart = 0;
+	int nEnd;
+
+	while (nStart < (int)value.length()) {
+		if (nCount == 4)
+			return false;
+		nEnd = value.indexOf(',', nStart);
+		if (nEnd < 0)
+			nEnd = value.length();
+		if (nEnd == nStart)
+			return false;
+		nFields[nCount++] = value.substring(nStart, nEnd).toInt();
+		nStart = nEnd + 1;
+	}
+	if (nCount != 4)
+		return false;
+	if (nFields[0] <= 0 || nFields[1] <= 0 || nFields[2] < 0 || nFields[3] < 0)
+		return false;
+
+	Shutter->BeginConfigUpdate();
+	Shutter->SetMaxSpeed(nFields[0]);
+	Shutter->SetAcceleration(nFields[1]);
+	Shutter->SetWatchdogInterval((unsigned long)nFields[2]);
+	Shutter->SetVoltsFromString(String(nFields[3]));
+	Shutter->EndConfigUpdate();
+	return true;
+}
+
 void ProcessMessages(String buffer)
 {
 	String value, wirelessMessage="";
@@ -353,6 +461,14 @@ void ProcessMessages(String buffer)
 	if (value.length() > 0)
 		hasValue = true;
 
+#ifdef XBEE_API_MODE
+    uint8_t nRotatorStatus;
+    // every frame from the rotator carries the rain status
+    if (XBee.getRemoteStatus(nRotatorStatus) && (bool(nRotatorStatus & XBEE_STATUS_RAINING) != isRaining)) {
+        ProcessMessages(String(RAIN_ROTATOR_GET) + String((nRotatorStatus & XBEE_STATUS_RAINING) ? "1" : "0"));
+    }
+#endif
+
 	DBPrintln("<<< Command:" + String(command) + " Value:" + value);
 
 	switch (command) {
@@ -459,6 +575,26 @@ void ProcessMessages(String buffer)
 			DBPrintln(wirelessMessage);
 			break;
 
+		case CONFIG_BLOB_CMD:
+			if (hasValue && !Shutter->SetConfigBlob(value)) {
+				DBPrintln("Bad config blob " + value);
+				wirelessMessage = String(CONFIG_BLOB_CMD) + "E";
+				break;
+			}
+			wirelessMessage = String(CONFIG_BLOB_CMD) + Shutter->GetConfigBlob();
+			break;
+
+		case CONFIG_SHUTTER_CMD:
+			if (hasValue && !ApplyConfig(value)) {
+				DBPrintln("Bad config " + value);
+				wirelessMessage = String(CONFIG_SHUTTER_CMD) + "E";
+				break;
+			}
+			// speed,acceleration,watchdog interval,volts,cutoff
+			wirelessMessage = String(CONFIG_SHUTTER_CMD) + String(Shutter->GetMaxSpeed()) + "," + String(Shutter->GetAcceleration()) + ","
+			                + String(Shutter->getWatchdogInterval()) + "," + Shutter->GetVoltString();
+			break;
+
 		case STEPSPER_SHUTTER_CMD:
 			if (hasValue) {
 				if (value.toInt() > 0) {
@@ -532,7 +668,7 @@ void ProcessMessages(String buffer)
 
 	if (wirelessMessage.length() > 0) {
 		DBPrintln(">>> Sending " + wirelessMessage);
-		Wireless.print(wirelessMessage +"#");
+		WirelessSend(wirelessMessage);
 	}
 }
 
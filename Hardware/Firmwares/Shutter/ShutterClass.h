@@ -16,6 +16,8 @@ DueFlashStorage dueFlashStorage;
 
 #include <AccelStepper.h>
 #include "StopWatch.h"
+#include <VoltageFilter.h>  // in Hardware/Firmwares/libraries
+#include <ConfigBlob.h>     // in Hardware/Firmwares/libraries
 
 // Debug printing, uncomment #define DEBUG to enable
 // #define DEBUG
@@ -83,6 +85,10 @@ typedef struct ShutterConfiguration {
     bool            bTopShutterOpenFirst;
 } Configuration;
 
+// config blob tags, never reuse one, new ones go at the end.
+enum ShutterConfigTags { SHUTTER_TAG_STEPS = 1, SHUTTER_TAG_ACCELERATION, SHUTTER_TAG_MAX_SPEED, SHUTTER_TAG_REVERSED, SHUTTER_TAG_CUTOFF,
+                        SHUTTER_TAG_WATCHDOG, SHUTTER_TAG_PANID, SHUTTER_TAG_DROP_SHUTTER, SHUTTER_TAG_TOP_FIRST };
+
 
 AccelStepper stepper(AccelStepper::DRIVER, STEPPER_STEP_PIN, STEPPER_DIRECTION_PIN);
 
@@ -168,6 +174,15 @@ void TC3_Handler()
     stepper.run();
 }
 
+VoltageFilter voltsFilter;
+
+// DUE battery voltage sampling callback
+void TC4_Handler()
+{
+    TC_GetStatus(TC1, 1);
+    voltsFilter.sample();
+}
+
 class ShutterClass
 {
 public:
@@ -225,6 +240,10 @@ public:
     // persistent data
     void        LoadFromEEProm();
     void        SaveToEEProm();
+    void        BeginConfigUpdate();
+    void        EndConfigUpdate();
+    String      GetConfigBlob();
+    bool        SetConfigBlob(const String &sHex);
     int         restoreDefaultMotorSettings();
 
     // interrupts
@@ -238,11 +257,9 @@ private:
 
     Configuration   m_Config;
     float           m_fAdcConvert;
-    int             m_nVolts;
     StopWatch       m_batteryCheckTimer;
     unsigned long   m_nBatteryCheckInterval;
 
-    int             MeasureVoltage();
     void            SetDefaultConfig();
 
     bool        m_bDoEEPromSave;
@@ -271,7 +288,7 @@ ShutterClass::ShutterClass()
     m_EEPROMpageSize = 64;
 #endif
 
-    m_fAdcConvert = RES_MULT * (AD_REF / 1023.0) * 100;
+    m_fAdcConvert = RES_MULT * (AD_REF / VOLTS_ADC_MAX) * 100;
 
     // Input pins
     pinMode(CLOSED_PIN,             INPUT);
@@ -308,7 +325,8 @@ ShutterClass::ShutterClass()
         shutterState = OPEN;
 
     m_bButtonUsed = false;
-    m_nVolts = MeasureVoltage();
+    voltsFilter.begin(VOLTAGE_MONITOR_PIN, m_fAdcConvert);
+    startTimer(TC1, 1, TC4_IRQn, VOLTS_SAMPLE_FREQ);
     m_bDoEEPromSave = true;
 }
 
@@ -426,6 +444,95 @@ void ShutterClass::SaveToEEProm()
 
 }
 
+// the setters called in between only change m_Config, EndConfigUpdate saves it once
+void ShutterClass::BeginConfigUpdate()
+{
+    m_bDoEEPromSave = false;
+}
+
+void ShutterClass::EndConfigUpdate()
+{
+    m_bDoEEPromSave = true;
+    SaveToEEProm();
+}
+
+// all the settings, see ConfigBlob.h
+String ShutterClass::GetConfigBlob()
+{
+    ConfigBlob blob(CONFIG_BLOB_SHUTTER);
+
+    blob.add(SHUTTER_TAG_STEPS, m_Config.stepsPerStroke, 4);
+    blob.add(SHUTTER_TAG_ACCELERATION, m_Config.acceleration, 4);
+    blob.add(SHUTTER_TAG_MAX_SPEED, m_Config.maxSpeed, 4);
+    blob.add(SHUTTER_TAG_REVERSED, m_Config.reversed, 1);
+    blob.add(SHUTTER_TAG_CUTOFF, m_Config.cutoffVolts, 2);
+    blob.add(SHUTTER_TAG_WATCHDOG, m_Config.watchdogInterval, 4);
+    blob.add(SHUTTER_TAG_PANID, m_Config.panid, 2);
+    blob.add(SHUTTER_TAG_DROP_SHUTTER, m_Config.bHasDropShutter, 1);
+    blob.add(SHUTTER_TAG_TOP_FIRST, m_Config.bTopShutterOpenFirst, 1);
+    return blob.toHex();
+}
+
+// Everything is checked before anything changes and the config is saved once.
+// The PAN ID is only there for reference, changing it needs both XBees to be reconfigured.
+bool ShutterClass::SetConfigBlob(const String &sHex)
+{
+    ConfigBlob blob(CONFIG_BLOB_SHUTTER);
+    Configuration newConfig;
+    uint8_t nTag;
+    unsigned long nValue;
+
+    if(!blob.fromHex(sHex))
+        return false;
+
+    // settings that are not in the blob keep their current value
+    memcpy(&newConfig, &m_Config, sizeof(Configuration));
+    while(blob.next(nTag, nValue)) {
+        switch(nTag) {
+            case SHUTTER_TAG_STEPS:
+                newConfig.stepsPerStroke = nValue;
+                break;
+            case SHUTTER_TAG_ACCELERATION:
+                newConfig.acceleration = (int)nValue;
+                break;
+            case SHUTTER_TAG_MAX_SPEED:
+                newConfig.maxSpeed = (int)nValue;
+                break;
+            case SHUTTER_TAG_REVERSED:
+                newConfig.reversed = (nValue != 0);
+                break;
+            case SHUTTER_TAG_CUTOFF:
+                newConfig.cutoffVolts = (int)nValue;
+                break;
+            case SHUTTER_TAG_WATCHDOG:
+                newConfig.watchdogInterval = nValue;
+                break;
+            case SHUTTER_TAG_DROP_SHUTTER:
+                newConfig.bHasDropShutter = (nValue != 0);
+                break;
+            case SHUTTER_TAG_TOP_FIRST:
+                newConfig.bTopShutterOpenFirst = (nValue != 0);
+                break;
+            default: // PAN ID or a tag from a newer firmware
+                break;
+        }
+    }
+
+    if(newConfig.stepsPerStroke == 0 || newConfig.acceleration <= 0 || newConfig.maxSpeed <= 0 || newConfig.cutoffVolts < 0)
+        return false;
+    if(newConfig.watchdogInterval > MAX_WATCHDOG_INTERVAL)
+        newConfig.watchdogInterval = MAX_WATCHDOG_INTERVAL;
+    if(newConfig.watchdogInterval < MIN_WATCHDOG_INTERVAL)
+        newConfig.watchdogInterval = MIN_WATCHDOG_INTERVAL;
+
+    memcpy(&m_Config, &newConfig, sizeof(Configuration));
+    stepper.setAcceleration(m_Config.acceleration);
+    stepper.setMaxSpeed(m_Config.maxSpeed);
+    stepper.setPinsInverted(m_Config.reversed, m_Config.reversed, m_Config.reversed);
+    SaveToEEProm();
+    return true;
+}
+
 float ShutterClass::PositionToAltitude(const long pos)
 {
     float result = (float)pos;
@@ -549,15 +656,12 @@ void ShutterClass::SetStepsPerStroke(const unsigned long newSteps)
 
 inline bool ShutterClass::GetVoltsAreLow()
 {
-    m_nVolts = MeasureVoltage();  // make sure we're using the current value
-    bool low = (m_nVolts <= m_Config.cutoffVolts);
-    return low;
+    return voltsFilter.isLow(m_Config.cutoffVolts);
 }
 
 String ShutterClass::GetVoltString()
 {
-    m_nVolts = MeasureVoltage();  // make sure we're reporting the current value
-    return String(m_nVolts) + "," + String(m_Config.cutoffVolts);
+    return String(voltsFilter.getVolts()) + "," + String(m_Config.cutoffVolts);
 }
 
 
@@ -567,17 +671,6 @@ void ShutterClass::SetVoltsFromString(const String value)
     SaveToEEProm();
 }
 
-int ShutterClass::MeasureVoltage()
-{
-    int adc;
-    float calc;
-
-    adc = analogRead(VOLTAGE_MONITOR_PIN);
-    calc = adc * m_fAdcConvert;
-    DBPrintln("ADC volts = " + String(calc/100));
-    return int(calc);
-}
-
 String ShutterClass::GetPANID()
 {
     return String(m_Config.panid, HEX);
@@ -647,7 +740,6 @@ void ShutterClass::EnableMotor(const bool newState)
 // Movers
 void ShutterClass::Open()
 {
-    m_nVolts = MeasureVoltage();
     if(GetVoltsAreLow()) // do not try to open if we're already at low voltage
         return;
 
@@ -687,8 +779,7 @@ void ShutterClass::Run()
     int sw1,sw2;
 
     if (m_batteryCheckTimer.elapsed() >= m_nBatteryCheckInterval) {
-        DBPrintln("Measuring Battery");
-        m_nVolts = MeasureVoltage();
+        DBPrintln("Checking Battery, volts = " + String(voltsFilter.getVolts()/100.0));
         if(GetVoltsAreLow() && shutterState!=CLOSED) {
             DBPrintln("Voltage is low, closing");
             Close();
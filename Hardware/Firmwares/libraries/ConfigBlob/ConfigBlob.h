@@ -0,0 +1,154 @@
+// Rodolphe Pineau
+// Versioned configuration blob, used to backup and restore all the settings in one command.
+// Layout : format version, kind ('R' rotator or 'S' shutter), records, CRC16 of all that (big endian).
+// A record is a tag, a size and the value in little endian (1 to 4 bytes).
+// Tags are never reused. A blob from a newer firmware can have tags we don't know, they are skipped.
+// A blob from an older firmware can miss some, these settings keep their current value.
+// The blob goes over the wire as hex.
+//
+// The rotator and the shutter share this header only Arduino library, it also provides crc16.
+// See XBeeAPI.h for how to make it visible to the IDE.
+//
+
+#ifndef ConfigBlob_h
+#define ConfigBlob_h
+
+#define CONFIG_BLOB_VERSION     1
+#define CONFIG_BLOB_MAX         120     // bytes
+#define CONFIG_BLOB_ROTATOR     'R'
+#define CONFIG_BLOB_SHUTTER     'S'
+
+// CRC-16/CCITT (poly 0x1021), pass the previous value as crc to continue a CRC over several buffers.
+uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF)
+{
+    size_t i;
+    int bit;
+
+    for(i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+class ConfigBlob
+{
+public:
+    ConfigBlob(const char cKind);
+    void    add(const uint8_t nTag, const unsigned long nValue, const uint8_t nSize);
+    String  toHex();
+    bool    fromHex(const String &sHex);
+    bool    next(uint8_t &nTag, unsigned long &nValue);
+
+private:
+    uint8_t m_Data[CONFIG_BLOB_MAX];
+    int     m_nLength;
+    int     m_nPos;
+    char    m_cKind;
+};
+
+ConfigBlob::ConfigBlob(const char cKind)
+{
+    m_cKind = cKind;
+    m_Data[0] = CONFIG_BLOB_VERSION;
+    m_Data[1] = cKind;
+    m_nLength = 2;
+    m_nPos = 2;
+}
+
+void ConfigBlob::add(const uint8_t nTag, const unsigned long nValue, const uint8_t nSize)
+{
+    int i;
+
+    if(m_nLength + 2 + nSize + 2 > CONFIG_BLOB_MAX)
+        return;
+    m_Data[m_nLength++] = nTag;
+    m_Data[m_nLength++] = nSize;
+    for(i = 0; i < nSize; i++)
+        m_Data[m_nLength++] = (nValue >> (8 * i)) & 0xFF;
+}
+
+String ConfigBlob::toHex()
+{
+    const char hexDigits[] = "0123456789abcdef";
+    uint16_t nCRC;
+    String sHex;
+    int i;
+
+    nCRC = crc16(m_Data, m_nLength);
+    m_Data[m_nLength] = nCRC >> 8;
+    m_Data[m_nLength + 1] = nCRC & 0xFF;
+
+    for(i = 0; i < m_nLength + 2; i++) {
+        sHex += hexDigits[m_Data[i] >> 4];
+        sHex += hexDigits[m_Data[i] & 0x0F];
+    }
+    return sHex;
+}
+
+// checks the format version, kind, CRC and that the records end right on the CRC
+bool ConfigBlob::fromHex(const String &sHex)
+{
+    int i;
+    int nDigit;
+    char c;
+    uint8_t nByte = 0;
+
+    if((sHex.length() & 1) || (int)sHex.length() / 2 > CONFIG_BLOB_MAX || sHex.length() < 8)
+        return false;
+
+    for(i = 0; i < (int)sHex.length(); i++) {
+        c = sHex.charAt(i);
+        if(c >= '0' && c <= '9')
+            nDigit = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            nDigit = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            nDigit = c - 'A' + 10;
+        else
+            return false;
+        nByte = (nByte << 4) | nDigit;
+        if(i & 1)
+            m_Data[i / 2] = nByte;
+    }
+    m_nLength = sHex.length() / 2 - 2;
+
+    if(crc16(m_Data, m_nLength) != (((uint16_t)m_Data[m_nLength] << 8) | m_Data[m_nLength + 1]))
+        return false;
+    if(m_Data[0] == 0 || m_Data[0] > CONFIG_BLOB_VERSION || m_Data[1] != m_cKind)
+        return false;
+
+    for(i = 2; i < m_nLength; i += 2 + m_Data[i + 1]) {
+        if(i + 2 > m_nLength)
+            return false;
+    }
+    if(i != m_nLength)
+        return false;
+
+    m_nPos = 2;
+    return true;
+}
+
+// values bigger than 4 bytes can only be from a newer firmware, they come back as 0 for a tag we don't know anyway.
+bool ConfigBlob::next(uint8_t &nTag, unsigned long &nValue)
+{
+    int i;
+    uint8_t nSize;
+
+    if(m_nPos >= m_nLength)
+        return false;
+
+    nTag = m_Data[m_nPos];
+    nSize = m_Data[m_nPos + 1];
+    nValue = 0;
+    if(nSize <= 4) {
+        for(i = 0; i < nSize; i++)
+            nValue |= (unsigned long)m_Data[m_nPos + 2 + i] << (8 * i);
+    }
+    m_nPos += 2 + nSize;
+    return true;
+}
+
+#endif
+// END OF FILE
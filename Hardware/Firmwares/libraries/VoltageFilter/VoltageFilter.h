@@ -0,0 +1,97 @@
+// Rodolphe Pineau
+// Battery voltage measurement : the ADC runs free on the monitor pin, a timer interrupt
+// samples it, sums VOLTS_OVERSAMPLE samples and feeds the sum to a fixed point IIR filter.
+// Reading the voltage is just returning the last filtered value, no ADC work.
+//
+// Header only Arduino library used by both the rotator and the shutter, see XBeeAPI.h
+// for how to make it visible to the IDE.
+//
+
+#ifndef VoltageFilter_h
+#define VoltageFilter_h
+
+#define VOLTS_SAMPLE_FREQ   1000    // Hz
+#define VOLTS_OVERSAMPLE    16      // samples summed per filter update
+#define VOLTS_IIR_SHIFT     6       // filter coefficient is 1/64, about 1s time constant
+#define VOLTS_HYSTERESIS    20      // 0.2V, volts need to go that far above the cutoff to clear the low flag
+#define VOLTS_ADC_MAX       4095.0  // the free running ADC gives us 12 bits
+
+class VoltageFilter
+{
+public:
+    VoltageFilter();
+    void begin(const int nPin, const float fCentiVoltsPerCount);
+    void sample();  // from the timer interrupt
+    int  getVolts();
+    bool isLow(const int nCutOff);
+
+private:
+    uint32_t        m_nChannel;
+    unsigned long   m_nScale;   // centivolts per count of the oversampled sum, 16.16 fixed point
+    unsigned long   m_nSum;
+    int             m_nCount;
+    long            m_nState;   // filtered oversampled sum << VOLTS_IIR_SHIFT
+    volatile int    m_nVolts;   // centivolts
+    bool            m_bLow;
+};
+
+VoltageFilter::VoltageFilter()
+{
+    m_nChannel = 0;
+    m_nScale = 0;
+    m_nSum = 0;
+    m_nCount = 0;
+    m_nState = 0;
+    m_nVolts = 0;
+    m_bLow = false;
+}
+
+void VoltageFilter::begin(const int nPin, const float fCentiVoltsPerCount)
+{
+    unsigned long nAdc;
+
+    m_nChannel = g_APinDescription[nPin].ulADCChannelNumber;
+    m_nScale = (unsigned long)(fCentiVoltsPerCount * 65536.0 / VOLTS_OVERSAMPLE + 0.5);
+
+    // start from an actual reading so we don't see a low voltage while the filter settles
+    analogReadResolution(12);
+    nAdc = analogRead(nPin);
+    m_nState = (long)(nAdc * VOLTS_OVERSAMPLE) << VOLTS_IIR_SHIFT;
+    m_nVolts = (int)((nAdc * VOLTS_OVERSAMPLE * m_nScale) >> 16);
+
+    // let the ADC convert the channel continuously, sample() only reads the last result
+    ADC->ADC_CHER = 1 << m_nChannel;
+    ADC->ADC_MR |= ADC_MR_FREERUN_ON;
+    ADC->ADC_CR = ADC_CR_START;
+}
+
+inline void VoltageFilter::sample()
+{
+    m_nSum += ADC->ADC_CDR[m_nChannel] & 0x0FFF;
+    if (++m_nCount < VOLTS_OVERSAMPLE)
+        return;
+
+    m_nState += (long)m_nSum - (m_nState >> VOLTS_IIR_SHIFT);
+    m_nVolts = (int)(((unsigned long)(m_nState >> VOLTS_IIR_SHIFT) * m_nScale) >> 16);
+    m_nSum = 0;
+    m_nCount = 0;
+}
+
+inline int VoltageFilter::getVolts()
+{
+    return m_nVolts;
+}
+
+inline bool VoltageFilter::isLow(const int nCutOff)
+{
+    int nVolts = m_nVolts;
+
+    if (nVolts <= nCutOff)
+        m_bLow = true;
+    else if (nVolts > nCutOff + VOLTS_HYSTERESIS)
+        m_bLow = false;
+    return m_bLow;
+}
+
+#endif
+// END OF FILE
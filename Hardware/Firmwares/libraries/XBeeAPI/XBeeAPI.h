@@ -0,0 +1,344 @@
+//
+// XBee API mode (ATAP1) transport between the rotator and the shutter.
+// Used when XBEE_API_MODE is defined instead of the transparent mode.
+//
+// Every radio frame carries one or more of the usual '#' terminated ASCII messages
+// prefixed by 2 bytes :
+//  - a sequence number so the receiver can drop frames the radio delivered twice.
+//  - a status byte so each side gets the other side telemetry with every message.
+// The radio TX status frame is used as the acknowledgement, frames that are not
+// delivered are resent up to XBEE_API_MAX_RETRY times.
+// Received messages are exposed through available()/read() so the existing
+// ASCII message parsing doesn't need to know about the frames.
+//
+// Shared by the rotator and shutter firmwares. This is a header only Arduino library,
+// it uses the DBPrintln and ERR_NO_DATA defines of the sketch including it.
+// Point the Arduino sketchbook location to Hardware/Firmwares or copy
+// Hardware/Firmwares/libraries/XBeeAPI to your own libraries folder.
+//
+
+#ifndef XBeeAPI_h
+#define XBeeAPI_h
+
+#define XBEE_API_BAUD           115200
+#define XBEE_FALLBACK_BAUD      9600
+
+#define XBEE_API_START          0x7E
+#define XBEE_API_MAX_FRAME      128
+#define XBEE_API_RX_BUFFER      256
+#define XBEE_API_MAX_RETRY      3
+#define XBEE_API_ACK_TIMEOUT    100 // ms
+
+#if defined(XBEE_S2C)
+#define XBEE_API_TX_REQUEST     0x10
+#define XBEE_API_TX_STATUS      0x8B
+#define XBEE_API_RX_PACKET      0x90
+#define XBEE_API_RX_DATA_OFFSET 12  // type, 64 bit addr, 16 bit addr, options
+#else
+#define XBEE_API_TX_REQUEST     0x01
+#define XBEE_API_TX_STATUS      0x89
+#define XBEE_API_RX_PACKET      0x81
+#define XBEE_API_RX_DATA_OFFSET 5   // type, 16 bit addr, rssi, options
+#endif
+
+// status byte piggy-backed on every frame
+#define XBEE_STATUS_STATE_MASK  0x0F    // shutter state, ShutterStates goes up to FINISHING_CLOSE (10)
+#define XBEE_STATUS_LOW_VOLTS   0x10
+#define XBEE_STATUS_RAINING     0x20
+#define XBEE_STATUS_VALID       0x80
+
+class XBeeAPI
+{
+public:
+    XBeeAPI(Stream &port, uint16_t nDestAddr);
+
+    void        setPassThrough(bool bPassThrough);
+    bool        send(const String &sMessage, uint8_t nStatus);
+    bool        lastSendDelivered();
+
+    int         available();
+    int         read();
+
+    bool        getRemoteStatus(uint8_t &nStatus);
+
+private:
+    Stream          &m_Port;
+    uint16_t        m_nDestAddr;
+    bool            m_bPassThrough;
+
+    // frame parser
+    uint8_t         m_Frame[XBEE_API_MAX_FRAME];
+    int             m_nParseState;
+    uint16_t        m_nFrameLen;
+    uint16_t        m_nFrameIndex;
+    uint8_t         m_nChecksum;
+
+    // decoded application data
+    uint8_t         m_RxData[XBEE_API_RX_BUFFER];
+    int             m_nRxHead;
+    int             m_nRxTail;
+
+    uint8_t         m_nFrameId;
+    uint8_t         m_nTxSeq;
+    uint8_t         m_nLastRxSeq;
+    int             m_nTxStatus;
+    bool            m_bLastDelivered;
+
+    uint8_t         m_nRemoteStatus;
+    bool            m_bNewRemoteStatus;
+
+#if defined(XBEE_S2C)
+    uint8_t         m_RemoteAddr64[8];
+    bool            m_bRemoteAddrKnown;
+#endif
+
+    void        poll();
+    void        processFrame();
+    void        pushRxByte(uint8_t nByte);
+    void        writeFrame(const String &sMessage, uint8_t nStatus);
+};
+
+XBeeAPI::XBeeAPI(Stream &port, uint16_t nDestAddr)
+    : m_Port(port)
+{
+    m_nDestAddr = nDestAddr;
+    m_bPassThrough = false;
+    m_nParseState = 0;
+    m_nFrameLen = 0;
+    m_nFrameIndex = 0;
+    m_nChecksum = 0;
+    m_nRxHead = 0;
+    m_nRxTail = 0;
+    m_nFrameId = 0;
+    m_nTxSeq = 0;
+    m_nLastRxSeq = 0;
+    m_nTxStatus = -1;
+    m_bLastDelivered = true;
+    m_nRemoteStatus = 0;
+    m_bNewRemoteStatus = false;
+#if defined(XBEE_S2C)
+    m_bRemoteAddrKnown = false;
+#endif
+}
+
+// while the radio is being configured we need to talk to it in AT mode
+void XBeeAPI::setPassThrough(bool bPassThrough)
+{
+    m_bPassThrough = bPassThrough;
+    m_nParseState = 0;
+    m_nRxHead = 0;
+    m_nRxTail = 0;
+    m_bLastDelivered = true;
+}
+
+bool XBeeAPI::send(const String &sMessage, uint8_t nStatus)
+{
+    int nRetry;
+    unsigned long nStart;
+
+    if(m_bPassThrough) {
+        m_Port.print(sMessage);
+        m_bLastDelivered = true;
+        return true;
+    }
+
+    m_nTxSeq++;
+    if(!m_nTxSeq) // 0 is never used so the first frame is never seen as a duplicate
+        m_nTxSeq = 1;
+
+    for(nRetry = 0; nRetry < XBEE_API_MAX_RETRY; nRetry++) {
+        m_nFrameId++;
+        if(!m_nFrameId) // frame id 0 means no TX status
+            m_nFrameId = 1;
+        m_nTxStatus = -1;
+        writeFrame(sMessage, nStatus);
+
+        nStart = millis();
+        while(m_nTxStatus < 0 && millis() - nStart < XBEE_API_ACK_TIMEOUT) {
+            poll();
+        }
+        if(m_nTxStatus == 0) {
+            m_bLastDelivered = true;
+            return true;
+        }
+        DBPrintln("[XBeeAPI::send] TX status " + String(m_nTxStatus) + " retry " + String(nRetry));
+    }
+    m_bLastDelivered = false;
+    return false;
+}
+
+bool XBeeAPI::lastSendDelivered()
+{
+    return m_bLastDelivered;
+}
+
+int XBeeAPI::available()
+{
+    if(m_bPassThrough)
+        return m_Port.available();
+
+    poll();
+    return (m_nRxHead - m_nRxTail + XBEE_API_RX_BUFFER) % XBEE_API_RX_BUFFER;
+}
+
+int XBeeAPI::read()
+{
+    uint8_t nByte;
+
+    if(m_bPassThrough)
+        return m_Port.read();
+
+    if(m_nRxHead == m_nRxTail)
+        return ERR_NO_DATA;
+    nByte = m_RxData[m_nRxTail];
+    m_nRxTail = (m_nRxTail + 1) % XBEE_API_RX_BUFFER;
+    return nByte;
+}
+
+bool XBeeAPI::getRemoteStatus(uint8_t &nStatus)
+{
+    if(!m_bNewRemoteStatus)
+        return false;
+    nStatus = m_nRemoteStatus;
+    m_bNewRemoteStatus = false;
+    return true;
+}
+
+void XBeeAPI::poll()
+{
+    uint8_t nByte;
+
+    while(m_Port.available() > 0) {
+        nByte = (uint8_t)m_Port.read();
+        switch(m_nParseState) {
+            case 0: // start delimiter
+                if(nByte == XBEE_API_START)
+                    m_nParseState = 1;
+                break;
+            case 1: // length MSB
+                m_nFrameLen = nByte << 8;
+                m_nParseState = 2;
+                break;
+            case 2: // length LSB
+                m_nFrameLen |= nByte;
+                m_nFrameIndex = 0;
+                m_nChecksum = 0;
+                if(m_nFrameLen == 0 || m_nFrameLen > XBEE_API_MAX_FRAME)
+                    m_nParseState = 0; // can't be valid, wait for the next start delimiter
+                else
+                    m_nParseState = 3;
+                break;
+            case 3: // frame data
+                m_Frame[m_nFrameIndex++] = nByte;
+                m_nChecksum += nByte;
+                if(m_nFrameIndex >= m_nFrameLen)
+                    m_nParseState = 4;
+                break;
+            case 4: // checksum
+                m_nChecksum += nByte;
+                if(m_nChecksum == 0xFF)
+                    processFrame();
+                else
+                    DBPrintln("[XBeeAPI::poll] bad checksum");
+                m_nParseState = 0;
+                break;
+        }
+    }
+}
+
+void XBeeAPI::processFrame()
+{
+    int i;
+
+    switch(m_Frame[0]) {
+        case XBEE_API_TX_STATUS:
+            if(m_Frame[1] != m_nFrameId)
+                break; // status for a frame we already gave up on
+#if defined(XBEE_S2C)
+            m_nTxStatus = m_Frame[5]; // delivery status
+#else
+            m_nTxStatus = m_Frame[2];
+#endif
+            break;
+
+        case XBEE_API_RX_PACKET:
+            if(m_nFrameLen < XBEE_API_RX_DATA_OFFSET + 2)
+                break;
+#if defined(XBEE_S2C)
+            // reply directly to whoever talked to us last instead of broadcasting
+            for(i = 0; i < 8; i++)
+                m_RemoteAddr64[i] = m_Frame[1+i];
+            m_bRemoteAddrKnown = true;
+#endif
+            m_nRemoteStatus = m_Frame[XBEE_API_RX_DATA_OFFSET + 1];
+            m_bNewRemoteStatus = true;
+            // same sequence number as the last frame, the radio delivered it twice.
+            if(m_Frame[XBEE_API_RX_DATA_OFFSET] == m_nLastRxSeq)
+                break;
+            m_nLastRxSeq = m_Frame[XBEE_API_RX_DATA_OFFSET];
+            for(i = XBEE_API_RX_DATA_OFFSET + 2; i < m_nFrameLen; i++)
+                pushRxByte(m_Frame[i]);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void XBeeAPI::pushRxByte(uint8_t nByte)
+{
+    int nNext;
+
+    nNext = (m_nRxHead + 1) % XBEE_API_RX_BUFFER;
+    if(nNext == m_nRxTail)
+        return; // full, drop
+    m_RxData[m_nRxHead] = nByte;
+    m_nRxHead = nNext;
+}
+
+void XBeeAPI::writeFrame(const String &sMessage, uint8_t nStatus)
+{
+    uint8_t header[14];
+    int nHeaderLen = 0;
+    int i;
+    uint16_t nLen;
+    uint8_t nChecksum = 0;
+
+    header[nHeaderLen++] = XBEE_API_TX_REQUEST;
+    header[nHeaderLen++] = m_nFrameId;
+#if defined(XBEE_S2C)
+    for(i = 0; i < 8; i++) {
+        if(m_bRemoteAddrKnown)
+            header[nHeaderLen++] = m_RemoteAddr64[i];
+        else // broadcast until we know who's there
+            header[nHeaderLen++] = (i < 6) ? 0x00 : 0xFF;
+    }
+    header[nHeaderLen++] = 0xFF;    // unknown 16 bit address
+    header[nHeaderLen++] = 0xFE;
+    header[nHeaderLen++] = 0x00;    // broadcast radius
+#else
+    header[nHeaderLen++] = (m_nDestAddr >> 8) & 0xFF;
+    header[nHeaderLen++] = m_nDestAddr & 0xFF;
+#endif
+    header[nHeaderLen++] = 0x00;    // options
+    header[nHeaderLen++] = m_nTxSeq;
+    header[nHeaderLen++] = nStatus | XBEE_STATUS_VALID;
+
+    nLen = nHeaderLen + sMessage.length();
+
+    m_Port.write((uint8_t)XBEE_API_START);
+    m_Port.write((uint8_t)((nLen >> 8) & 0xFF));
+    m_Port.write((uint8_t)(nLen & 0xFF));
+    for(i = 0; i < nHeaderLen; i++) {
+        m_Port.write(header[i]);
+        nChecksum += header[i];
+    }
+    for(i = 0; i < (int)sMessage.length(); i++) {
+        m_Port.write((uint8_t)sMessage.charAt(i));
+        nChecksum += (uint8_t)sMessage.charAt(i);
+    }
+    m_Port.write((uint8_t)(0xFF - nChecksum));
+}
+
+#endif
+// END OF FILE
@@ -22,9 +22,45 @@ CRTIDome::CRTIDome()
     m_dCurrentAzPosition = 0.0;
     m_dCurrentElPosition = 0.0;
 
+    m_nRotationSpeed = 0;
+    m_nRotationAcceleration = 0;
+    m_bMoveModelActive = false;
+    m_dMoveTargetAz = 0.0;
+    m_dMoveSteps = 0.0;
+    m_nMoveDirection = MOVE_NONE;
+    m_dMoveTimeOffset = 0.0;
+    m_dGotoTimeCorrection = 1.0;
+    m_bTimingGoto = false;
+    m_dGotoPredictedTime = 0.0;
+
+    m_dSlitWidth = 0.0;
+    m_dSlitHysteresis = 0.0;
+    m_bGotoInProgress = false;
+    m_bGotoSuppressed = false;
+    m_bPendingGoto = false;
+    m_dPendingGotoAz = 0.0;
+    m_nAvoidedGotos = 0;
+
+    m_bLinkDown = false;
+    m_bPortReopened = false;
+    m_bSupervisorRunning = false;
+    m_nConsecutiveTimeouts = 0;
+    m_nReconnects = 0;
+
+    m_bTaggedFrames = true;
+    m_bBinaryFrames = true;
+    m_bBinaryMode = false;
+    m_nCrcErrors = 0;
+    m_nSequence = 0;
+    m_nStaleReplies = 0;
+
+    m_bShutterLinkDown = false;
+    m_nShutterTimeouts = 0;
+
     m_bCalibrating = false;
     m_bParking = false;
     m_bUnParking = false;
+    m_bWaypoints = false;
 
     m_bShutterOpened = false;
 
@@ -86,6 +122,25 @@ CRTIDome::CRTIDome()
     m_sRainStatusfilePath = getenv("HOME");
     m_sRainStatusfilePath += "/RTI_Rain.txt";
 #endif
+
+#if defined(SB_WIN_BUILD)
+    m_sProfilefilePath = getenv("HOMEDRIVE");
+    m_sProfilefilePath += getenv("HOMEPATH");
+    m_sProfilefilePath += "\\RTI-Dome-Profiles.txt";
+    m_sConfigBackupfilePath = getenv("HOMEDRIVE");
+    m_sConfigBackupfilePath += getenv("HOMEPATH");
+    m_sConfigBackupfilePath += "\\RTI-Dome-Config.txt";
+#elif defined(SB_LINUX_BUILD)
+    m_sProfilefilePath = getenv("HOME");
+    m_sProfilefilePath += "/RTI-Dome-Profiles.txt";
+    m_sConfigBackupfilePath = getenv("HOME");
+    m_sConfigBackupfilePath += "/RTI-Dome-Config.txt";
+#elif defined(SB_MAC_BUILD)
+    m_sProfilefilePath = getenv("HOME");
+    m_sProfilefilePath += "/RTI-Dome-Profiles.txt";
+    m_sConfigBackupfilePath = getenv("HOME");
+    m_sConfigBackupfilePath += "/RTI-Dome-Config.txt";
+#endif
     
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [CRTIDome] Version " << std::fixed << std::setprecision(2) << PLUGIN_VERSION << " build " << __DATE__ << " " << __TIME__ << std::endl;
@@ -98,6 +153,7 @@ CRTIDome::CRTIDome()
 
 CRTIDome::~CRTIDome()
 {
+    stopLinkSupervisor();
 #ifdef	PLUGIN_DEBUG
     // Close LogFile
     if(m_sLogFile.is_open())
@@ -108,13 +164,13 @@ CRTIDome::~CRTIDome()
 int CRTIDome::Connect(const char *pszPort)
 {
     int nErr;
-    bool bDummy;
     
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] Called." << std::endl;
     m_sLogFile.flush();
 #endif
 
+    stopLinkSupervisor();
     // 115200 8N1 DTR
     nErr = m_pSerx->open(pszPort, 115200, SerXInterface::B_NOPARITY, "-DTR_CONTROL 1");
     if(nErr) {
@@ -140,65 +196,140 @@ int CRTIDome::Connect(const char *pszPort)
     m_sLogFile.flush();
 #endif
 
-    nErr = getIpAddress(m_IpAddress);
-    if(nErr)
-        m_IpAddress = "";
-    nErr |= getSubnetMask(m_SubnetMask);
-    if(nErr)
-        m_SubnetMask = "";
-    nErr |= getIPGateway(m_GatewayIP);
-    if(nErr)
-        m_GatewayIP = "";
-    nErr |= getUseDHCP(m_bUseDHCP);
-    if(nErr)
-        m_bUseDHCP = false;
+    m_bLinkDown = false;
+    m_bPortReopened = false;
+    m_nConsecutiveTimeouts = 0;
+    nErr = readControllerState();
+    if(nErr == FIRMWARE_NOT_SUPPORTED) {
+        m_bIsConnected = false;
+        m_pSerx->close();
+        return nErr;
+    }
+    negotiateBinaryFrames();
+    // only the network can come back by itself, a USB port that disappeared needs the user.
+    if(m_bNetworkConnected)
+        startLinkSupervisor();
+    return nErr;
+}
+
+// everything we need to know about the controller after opening the port, used on connect and reconnect.
+int CRTIDome::readControllerState()
+{
+    int nErr;
+    bool bDummy;
+    bool bShutterPresent;
+    int nShutterState;
+    double dDomeAz;
+    float fCachedVersion;
+    std::string sFingerprint;
+    std::string sResp;
+    std::vector<std::string> svCmds;
+    std::vector<std::string> svResps;
+
+    // the firmware might have changed, don't use tagged or binary frames until we know its version
+    m_fVersion = 0.0;
+    m_bBinaryMode = false;
+
+    // if we already know this controller we only need one round trip,
+    // the reply has the azimuth and, if it knows binary frames, it switches to them after replying.
+    fCachedVersion = getCachedFirmwareVersion();
+    nErr = getFingerprint(sFingerprint, bShutterPresent, nShutterState, dDomeAz,
+                          m_bBinaryFrames && fCachedVersion >= FINGERPRINT_STATE_MIN_VERSION);
+    if(!nErr && loadProfile(sFingerprint)) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-    if(nErr) {
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] Board without network feature." << std::endl;
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readControllerState] using cached profile for " << m_Port << " : " << sFingerprint << std::endl;
         m_sLogFile.flush();
+#endif
+        m_bShutterPresent = bShutterPresent;
+        m_nShutterState = bShutterPresent ? nShutterState : SHUTTER_ERROR;
+        m_bMoveModelActive = false;
+        if(m_fVersion >= FINGERPRINT_STATE_MIN_VERSION) {
+            // the rotator sent the hello to the shutter before replying
+            m_dCurrentAzPosition = dDomeAz;
+            return SB_OK;
+        }
+        // on a background reconnect the dome can be anywhere
+        if(getDomeAz(m_dCurrentAzPosition))
+            m_dCurrentAzPosition = m_dParkAz;
+        // the fingerprint already told us if the shutter is there and its state,
+        // the hello is only so the rotator refreshes its shutter values.
+        // Wait for its reply, without sequence ids a late one would be taken as the answer to the next command.
+        domeCommand("H#", sFingerprint, 'H');
+        return SB_OK;
     }
+
+    // the controller changed since we saved its profile, go back to ASCII for the long connect.
+    if(m_bBinaryMode) {
+        domeCommand("B0#", sResp, 'B');
+        m_bBinaryMode = false;
+    }
+
+    // we need to ask for everything, send all the requests at once.
+    svCmds = {"j#", "p#", "u#", "w#", "v#", "l#", "i#", "t#", "r#", "e#"};
+    nErr = domeCommands(svCmds, svResps);
+    if(nErr) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readControllerState] Error Getting Firmware : " << nErr << std::endl;
+        m_sLogFile.flush();
 #endif
+        return FIRMWARE_NOT_SUPPORTED;
+    }
+
+    // an empty response means the board doesn't have the network feature
+    m_IpAddress = svResps[0];
+    m_SubnetMask = svResps[1];
+    m_GatewayIP = svResps[2];
+    m_bUseDHCP = (svResps[3].size() && svResps[3].at(0) != '0');
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] Getting Firmware." << std::endl;
-    m_sLogFile.flush();
+    if(m_IpAddress.empty()) {
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readControllerState] Board without network feature." << std::endl;
+        m_sLogFile.flush();
+    }
 #endif
 
     // if this fails we're not properly connected.
-    nErr = getFirmwareVersion(m_sFirmwareVersion, m_fVersion);
-    if(nErr) {
+    if(svResps[4].empty()) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] Error Getting Firmware : " << nErr << std::endl;
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readControllerState] Error Getting Firmware." << std::endl;
         m_sLogFile.flush();
 #endif
-        m_bIsConnected = false;
-        m_pSerx->close();
         return FIRMWARE_NOT_SUPPORTED;
     }
+    parseFirmwareVersion(svResps[4], m_sFirmwareVersion, m_fVersion);
 
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect]Got Firmware "<<  m_sFirmwareVersion << "( " << std::fixed << std::setprecision(2) << m_fVersion << ")."<< nErr << std::endl;
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readControllerState] Got Firmware "<<  m_sFirmwareVersion << "( " << std::fixed << std::setprecision(2) << m_fVersion << ")."<< nErr << std::endl;
     m_sLogFile.flush();
 #endif
     if(m_fVersion < 2.0f && m_fVersion != 0.523f && m_fVersion != 0.522f)  {
         return FIRMWARE_NOT_SUPPORTED;
     }
 
-    nErr = getDomeParkAz(m_dCurrentAzPosition);
-    if(nErr) {
+    if(svResps[5].empty() || svResps[6].empty()) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] getDomeParkAz nErr : " << nErr << std::endl;
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readControllerState] Error getting park and home Az" << std::endl;
         m_sLogFile.flush();
 #endif
-        return nErr;
+        return BAD_CMD_RESPONSE;
     }
-    nErr = getDomeHomeAz(m_dHomeAz);
-    if(nErr) {
+    // the move model can live without steps, speed and acceleration, we'll just ask the controller for the position.
+    try {
+        m_dParkAz = std::stof(svResps[5]);
+        m_dHomeAz = std::stof(svResps[6]);
+        m_nNbStepPerRev = svResps[7].size() ? std::stoi(svResps[7]) : 0;
+        m_nRotationSpeed = svResps[8].size() ? std::stoi(svResps[8]) : 0;
+        m_nRotationAcceleration = svResps[9].size() ? std::stoi(svResps[9]) : 0;
+    }
+    catch(const std::exception& e) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] getDomeHomeAz nErr : " << nErr << std::endl;
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readControllerState] convertsion exception = " << e.what() << std::endl;
         m_sLogFile.flush();
 #endif
-        return nErr;
+        return BAD_CMD_RESPONSE;
     }
+    m_bMoveModelActive = false;
+    if(getDomeAz(m_dCurrentAzPosition))
+        m_dCurrentAzPosition = m_dParkAz;
 
     sendShutterHello();
     std::this_thread::sleep_for(std::chrono::milliseconds(250));
@@ -206,11 +337,16 @@ int CRTIDome::Connect(const char *pszPort)
     // we need to get the initial state
     getShutterState(m_nShutterState);
 
+    // older firmware don't have the fingerprint command, we'll do the long connect every time.
+    if(sFingerprint.size())
+        saveProfile(sFingerprint);
+
     return SB_OK;
 }
 
 void CRTIDome::Disconnect()
 {
+    stopLinkSupervisor();
     if(m_bIsConnected) {
         abortCurrentCommand();
         m_pSerx->purgeTxRx();
@@ -219,9 +355,14 @@ void CRTIDome::Disconnect()
     m_bIsConnected = false;
     m_bCalibrating = false;
     m_bUnParking = false;
+    m_bLinkDown = false;
+    m_bPortReopened = false;
 
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Disconnect] m_bIsConnected : " << (m_bIsConnected?"true":"false") << std::endl;
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Disconnect] m_nAvoidedGotos : " << m_nAvoidedGotos << std::endl;
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Disconnect] m_nStaleReplies : " << m_nStaleReplies << std::endl;
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Disconnect] m_nCrcErrors : " << m_nCrcErrors << std::endl;
     m_sLogFile.flush();
 #endif
 }
@@ -231,16 +372,58 @@ int CRTIDome::domeCommand(const std::string sCmd, std::string &sResp, char respC
     int nErr = PLUGIN_OK;
     unsigned long  ulBytesWrite;
     std::string localResp;
+    std::string sFullCmd;
+    std::string sTag;
+    std::string sPayload;
+    char szTag[4];
+    bool bTagged;
+    uint8_t nSequence = 0;
 
     if(!m_bIsConnected)
         return ERR_COMMNOLINK;
 
-    m_pSerx->purgeTxRx();
+    // don't wait for a timeout on each command while we're trying to reconnect
+    if(m_bLinkDown) {
+        if(!m_bPortReopened || resumeLink())
+            return ERR_COMMNOLINK;
+    }
+
+    if(!checkShutterLink(sCmd))
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_SHUTTER_UNAVAILABLE);
+
+    std::lock_guard<std::recursive_mutex> lock(m_DevMutex);
+
+    bTagged = !m_bBinaryMode && m_bTaggedFrames && m_fVersion >= TAGGED_FRAMES_MIN_VERSION;
+    if(m_bBinaryMode) {
+        // binary frames carry their own sequence id and CRC
+        sPayload = sCmd.substr(0, sCmd.find('#'));
+        if(sPayload.size() > BIN_MAX_PAYLOAD) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [domeCommand] command too long for a frame : " << sPayload.size() << std::endl;
+            m_sLogFile.flush();
+#endif
+            return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+        }
+        m_nSequence = (m_nSequence + 1) & 0xFF;
+        nSequence = (uint8_t)m_nSequence;
+        sFullCmd = buildFrame(sPayload, nSequence);
+    }
+    else if(bTagged) {
+        m_nSequence = (m_nSequence + 1) & 0xFF;
+        snprintf(szTag, sizeof(szTag), "~%02X", m_nSequence);
+        sTag.assign(szTag);
+        sFullCmd = sTag + sCmd;
+    }
+    else {
+        // without sequence ids we can't tell a late reply from ours, throw away anything left.
+        m_pSerx->purgeTxRx();
+        sFullCmd = sCmd;
+    }
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [domeCommand] Sending : " << sCmd << std::endl;
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [domeCommand] Sending : " << sTag << sCmd << (m_bBinaryMode?" (binary)":"") << std::endl;
     m_sLogFile.flush();
 #endif
-    nErr = m_pSerx->writeFile((void *)(sCmd.c_str()), sCmd.size(), ulBytesWrite);
+    nErr = m_pSerx->writeFile((void *)(sFullCmd.c_str()), sFullCmd.size(), ulBytesWrite);
     m_pSerx->flushTx();
 
     if(nErr){
@@ -248,6 +431,7 @@ int CRTIDome::domeCommand(const std::string sCmd, std::string &sResp, char respC
         m_sLogFile << "["<<getTimeStamp()<<"]"<< " [domeCommand] writeFile error : " << nErr << std::endl;
         m_sLogFile.flush();
 #endif
+        checkLink(nErr);
         return nErr;
     }
 
@@ -255,7 +439,14 @@ int CRTIDome::domeCommand(const std::string sCmd, std::string &sResp, char respC
         return nErr;
 
     // read response
-    nErr = readResponse(localResp, nTimeout);
+    if(m_bBinaryMode)
+        nErr = readFrame(nSequence, localResp, nTimeout);
+    else if(bTagged)
+        nErr = readTaggedResponse(sTag, localResp, nTimeout);
+    else
+        nErr = readResponse(localResp, nTimeout);
+    checkLink(nErr);
+    updateShutterLink(sCmd, nErr, localResp);
     if(nErr)
         return nErr;
 
@@ -266,6 +457,9 @@ int CRTIDome::domeCommand(const std::string sCmd, std::string &sResp, char respC
         nErr = BAD_CMD_RESPONSE;
 
     sResp = localResp.substr(1, localResp.size());
+    // the controller knows the shutter is not answering
+    if(!nErr && m_bShutterLinkDown && isShutterCommand(sCmd) && sResp == "U")
+        nErr = MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_SHUTTER_UNAVAILABLE);
 
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [domeCommand] response : " << sResp << std::endl;
@@ -275,6 +469,388 @@ int CRTIDome::domeCommand(const std::string sCmd, std::string &sResp, char respC
     return nErr;
 }
 
+#pragma mark - binary frames
+
+// CRC-16/CCITT (poly 0x1021), same as the firmware
+static uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF)
+{
+    size_t i;
+    int bit;
+
+    for(i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+// start, length, sequence, payload, CRC16 of length+sequence+payload (big endian)
+// the payload is at most BIN_MAX_PAYLOAD bytes, domeCommand checks it.
+std::string CRTIDome::buildFrame(const std::string &sPayload, uint8_t nSequence)
+{
+    std::string sFrame;
+    uint16_t nCRC;
+    size_t nLength;
+
+    nLength = sPayload.size();
+    sFrame.push_back((char)BIN_FRAME_START);
+    sFrame.push_back((char)nLength);
+    sFrame.push_back((char)nSequence);
+    sFrame.append(sPayload, 0, nLength);
+    nCRC = crc16((const uint8_t *)sFrame.data() + 1, nLength + 2);
+    sFrame.push_back((char)(nCRC >> 8));
+    sFrame.push_back((char)(nCRC & 0xFF));
+    return sFrame;
+}
+
+int CRTIDome::readBytes(uint8_t *pBuf, int nBytes, int nTimeout)
+{
+    int nErr = PLUGIN_OK;
+    int nBytesWaiting = 0;
+    int nbTimeouts = 0;
+    unsigned long ulBytesRead = 0;
+
+    while(nBytes > 0) {
+        nErr = m_pSerx->bytesWaitingRx(nBytesWaiting);
+        if(nErr)
+            return nErr;
+        if(!nBytesWaiting) {
+            nbTimeouts += MAX_READ_WAIT_TIMEOUT;
+            if(nbTimeouts >= nTimeout)
+                return COMMAND_TIMEOUT;
+            std::this_thread::sleep_for(std::chrono::milliseconds(MAX_READ_WAIT_TIMEOUT));
+            continue;
+        }
+        nbTimeouts = 0;
+        nErr = m_pSerx->readFile(pBuf, std::min(nBytesWaiting, nBytes), ulBytesRead, nTimeout);
+        if(nErr)
+            return nErr;
+        pBuf += ulBytesRead;
+        nBytes -= (int)ulBytesRead;
+    }
+    return nErr;
+}
+
+// read frames until we get the one with our sequence id. Corrupted and late frames are dropped.
+int CRTIDome::readFrame(uint8_t nSequence, std::string &sPayload, int nTimeout)
+{
+    int nErr;
+    int nFrames;
+    uint8_t cByte;
+    uint8_t frame[BIN_MAX_PAYLOAD + 4];
+    int nLength;
+
+    for(nFrames = 0; nFrames < MAX_STALE_READS; nFrames++) {
+        // look for the start of a frame
+        do {
+            nErr = readBytes(&cByte, 1, nTimeout);
+            if(nErr)
+                return nErr;
+        } while(cByte != BIN_FRAME_START);
+
+        nErr = readBytes(frame, 2, nTimeout);
+        if(nErr)
+            return nErr;
+        nLength = frame[0];
+        if(!nLength)
+            continue;
+        if(nLength > BIN_MAX_PAYLOAD) {
+            // not from this firmware or a corrupted length, we can't tell where the next frame starts
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readFrame] frame too long : " << nLength << std::endl;
+            m_sLogFile.flush();
+#endif
+            m_pSerx->purgeTxRx();
+            return BAD_CMD_RESPONSE;
+        }
+        nErr = readBytes(frame + 2, nLength + 2, nTimeout);
+        if(nErr)
+            return nErr;
+
+        if(crc16(frame, nLength + 2) != (((uint16_t)frame[nLength + 2] << 8) | frame[nLength + 3])) {
+            m_nCrcErrors++;
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readFrame] CRC error, m_nCrcErrors = " << m_nCrcErrors << std::endl;
+            m_sLogFile.flush();
+#endif
+            continue;
+        }
+        if(frame[1] != nSequence) {
+            m_nStaleReplies++;
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readFrame] waiting for " << (int)nSequence << ", dropping stale frame " << (int)frame[1] << std::endl;
+            m_sLogFile.flush();
+#endif
+            continue;
+        }
+        if(nLength == 1 && frame[2] == BIN_CRC_ERROR) {
+            // the controller got a corrupted command
+            m_nCrcErrors++;
+            return BAD_CMD_RESPONSE;
+        }
+        if(nLength == 1 && frame[2] == BIN_REPLY_TOO_LONG) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readFrame] the controller reply doesn't fit in a frame" << std::endl;
+            m_sLogFile.flush();
+#endif
+            return BAD_CMD_RESPONSE;
+        }
+        sPayload.assign((const char *)frame + 2, nLength);
+        return PLUGIN_OK;
+    }
+    return COMMAND_TIMEOUT;
+}
+
+int CRTIDome::negotiateBinaryFrames()
+{
+    int nErr;
+    std::string sResp;
+
+    // already switched by the fingerprint request
+    if(m_bBinaryMode || !m_bBinaryFrames || m_fVersion < BINARY_FRAMES_MIN_VERSION)
+        return PLUGIN_OK;
+
+    nErr = domeCommand("B1#", sResp, 'B');
+    if(!nErr && sResp == "1")
+        m_bBinaryMode = true;
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [negotiateBinaryFrames] m_bBinaryMode = " << (m_bBinaryMode?"Yes":"No") << std::endl;
+    m_sLogFile.flush();
+#endif
+    return nErr;
+}
+
+// azimuth, direction and home status in one fixed point reply
+int CRTIDome::getBinaryStatus(double &dDomeAz, int &nDirection, int &nHomeStatus)
+{
+    int nErr;
+    std::string sResp;
+    const uint8_t *pStatus;
+
+    nErr = domeCommand(std::string(1, (char)BIN_STATUS_CMD) + "#", sResp, (char)BIN_STATUS_CMD);
+    if(nErr)
+        return nErr;
+    if(sResp.size() < BIN_STATUS_SIZE - 1)
+        return BAD_CMD_RESPONSE;
+
+    pStatus = (const uint8_t *)sResp.data();
+    dDomeAz = (pStatus[0] | (pStatus[1] << 8)) / 100.0;
+    nDirection = (int8_t)pStatus[2];
+    nHomeStatus = pStatus[3];
+    return nErr;
+}
+
+// read until we get the reply with our tag, replies to commands that timed out before are dropped.
+int CRTIDome::readTaggedResponse(const std::string &sTag, std::string &sResp, int nTimeout)
+{
+    int nErr;
+    int nReads;
+    std::string sFrames;
+    std::vector<std::string> svFrames;
+
+    for(nReads = 0; nReads < MAX_STALE_READS; nReads++) {
+        nErr = readResponse(sFrames, nTimeout);
+        if(nErr)
+            return nErr;
+        // there can be more than one reply in the buffer
+        if(parseFields(sFrames, svFrames, '#'))
+            continue;
+        for(const std::string &sFrame : svFrames) {
+            if(sFrame.size() >= sTag.size() && sFrame.compare(0, sTag.size(), sTag) == 0) {
+                sResp = sFrame.substr(sTag.size());
+                return PLUGIN_OK;
+            }
+            m_nStaleReplies++;
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [readTaggedResponse] waiting for " << sTag << ", dropping stale reply : " << sFrame << std::endl;
+            m_sLogFile.flush();
+#endif
+        }
+    }
+    return COMMAND_TIMEOUT;
+}
+
+#pragma mark - shutter link
+
+// commands the controller forwards to the shutter over the XBee link.
+// We always try to close the shutter.
+bool CRTIDome::isShutterCommand(const std::string &sCmd)
+{
+    if(sCmd.empty())
+        return false;
+
+    switch(sCmd.at(0)) {
+        case 'D':   // restore motor default
+        case 'E':   // acceleration
+        case 'I':   // watchdog interval
+        case 'K':   // volts
+        case 'M':   // state
+        case 'O':   // open
+        case 'Q':   // PAN ID
+        case 'R':   // speed
+        case 'T':   // steps per stroke
+        case 'V':   // version
+        case 'Y':   // reversed
+            return true;
+        default:
+            return false;
+    }
+}
+
+// returns false if we shouldn't send the command because the shutter is not answering.
+// When the link is down one command goes through every SHUTTER_PROBE_INTERVAL to see if the shutter is back.
+bool CRTIDome::checkShutterLink(const std::string &sCmd)
+{
+    if(!m_bShutterLinkDown || !isShutterCommand(sCmd))
+        return true;
+
+    if(m_ShutterProbeTimer.GetElapsedSeconds() < SHUTTER_PROBE_INTERVAL)
+        return false;
+
+    m_ShutterProbeTimer.Reset();
+    return true;
+}
+
+void CRTIDome::updateShutterLink(const std::string &sCmd, int nErr, const std::string &sResp)
+{
+    bool bShutterLinkDown;
+
+    if(!isShutterCommand(sCmd))
+        return;
+
+    bShutterLinkDown = m_bShutterLinkDown;
+    // firmware that tracks the shutter link tells us right away with a "U" reply
+    if(!nErr && sResp.size() == 2 && sResp.at(1) == 'U') {
+        m_nShutterTimeouts = SHUTTER_DOWN_TIMEOUTS;
+        m_bShutterLinkDown = true;
+    }
+    else if(nErr == COMMAND_TIMEOUT || nErr == ERR_RXTIMEOUT) {
+        m_nShutterTimeouts++;
+        if(m_nShutterTimeouts >= SHUTTER_DOWN_TIMEOUTS)
+            m_bShutterLinkDown = true;
+    }
+    else if(!nErr) {
+        m_nShutterTimeouts = 0;
+        m_bShutterLinkDown = false;
+    }
+
+    if(m_bShutterLinkDown && !bShutterLinkDown)
+        m_ShutterProbeTimer.Reset();
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    if(m_bShutterLinkDown != bShutterLinkDown) {
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [updateShutterLink] shutter link is " << (m_bShutterLinkDown?"down":"up") << std::endl;
+        m_sLogFile.flush();
+    }
+#endif
+}
+
+#pragma mark - link supervisor
+
+// called with the result of every exchange with the controller.
+// This runs on the caller thread, and the supervisor thread can be the one calling, so it only raises the flag.
+void CRTIDome::checkLink(int nErr)
+{
+    if(nErr != COMMAND_TIMEOUT && nErr != ERR_COMMNOLINK && nErr != ERR_TXTIMEOUT && nErr != ERR_RXTIMEOUT) {
+        m_nConsecutiveTimeouts = 0;
+        return;
+    }
+
+    m_nConsecutiveTimeouts++;
+    if(!m_bNetworkConnected || m_nConsecutiveTimeouts < LINK_DOWN_TIMEOUTS || m_bLinkDown)
+        return;
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [checkLink] " << m_nConsecutiveTimeouts << " timeouts in a row, link is down" << std::endl;
+    m_sLogFile.flush();
+#endif
+    m_bLinkDown = true;
+}
+
+// The supervisor reopened the port, read the controller state again.
+// Called from domeCommand(s) so it runs on the caller thread, under the X2 lock when the caller is TheSkyX.
+int CRTIDome::resumeLink()
+{
+    int nErr;
+
+    m_bPortReopened = false;
+    m_bLinkDown = false;
+    m_nConsecutiveTimeouts = 0;
+    nErr = readControllerState();
+    if(nErr) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [resumeLink] reconnect failed : " << nErr << std::endl;
+        m_sLogFile.flush();
+#endif
+        m_bLinkDown = true; // the supervisor will try again
+        return ERR_COMMNOLINK;
+    }
+    negotiateBinaryFrames();
+    m_nReconnects++;
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [resumeLink] reconnected to " << m_Port << ", m_nReconnects = " << m_nReconnects << std::endl;
+    m_sLogFile.flush();
+#endif
+    return PLUGIN_OK;
+}
+
+// only Connect and Disconnect start and stop the supervisor
+void CRTIDome::startLinkSupervisor()
+{
+    m_bSupervisorRunning = true;
+    m_LinkSupervisorThread = std::thread(&CRTIDome::linkSupervisor, this);
+}
+
+void CRTIDome::stopLinkSupervisor()
+{
+    m_bSupervisorRunning = false;
+    if(m_LinkSupervisorThread.joinable())
+        m_LinkSupervisorThread.join();
+}
+
+// While the link is down, reopen the port in the background waiting longer after each failure.
+// It only touches the port, under m_DevMutex, never the dome state or the log file.
+void CRTIDome::linkSupervisor()
+{
+    int nErr;
+    int nDelay = LINK_RETRY_MIN_DELAY;
+    int nWait;
+    std::minstd_rand randGen((unsigned int)std::chrono::steady_clock::now().time_since_epoch().count());
+
+    while(m_bSupervisorRunning) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if(!m_bLinkDown) {
+            nDelay = LINK_RETRY_MIN_DELAY;
+            continue;
+        }
+        if(m_bPortReopened)
+            continue; // waiting for the next command to use it
+
+        // random jitter so several plugins don't hammer the controller at the same time
+        nWait = nDelay + (int)(randGen() % (nDelay/4 + 1));
+        while(nWait > 0 && m_bSupervisorRunning) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            nWait -= 100;
+        }
+        if(!m_bSupervisorRunning)
+            break;
+
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_DevMutex);
+            m_pSerx->close();
+            nErr = m_pSerx->open(m_Port.c_str(), 115200, SerXInterface::B_NOPARITY, "-DTR_CONTROL 1");
+        }
+        if(!nErr)
+            m_bPortReopened = true;
+
+        nDelay *= 2;
+        if(nDelay > LINK_RETRY_MAX_DELAY)
+            nDelay = LINK_RETRY_MAX_DELAY;
+    }
+}
+
 int CRTIDome::readResponse(std::string &sResp, int nTimeout)
 {
     int nErr = PLUGIN_OK;
@@ -347,38 +923,116 @@ int CRTIDome::readResponse(std::string &sResp, int nTimeout)
 }
 
 
-int CRTIDome::getDomeAz(double &dDomeAz)
+// send all the commands at once and read the responses in order.
+// svResps[i] is the response to svCmds[i] without the command code, or empty if it's not the expected one.
+int CRTIDome::domeCommands(const std::vector<std::string> &svCmds, std::vector<std::string> &svResps, int nTimeout)
 {
     int nErr = PLUGIN_OK;
-    std::string sResp;
+    unsigned long  ulBytesWrite;
+    std::string sCmds;
+    std::string localResp;
+    std::vector<std::string> svFields;
+    std::vector<std::string> svRawResps;
+    size_t i;
 
+    svResps.clear();
     if(!m_bIsConnected)
-        return NOT_CONNECTED;
+        return ERR_COMMNOLINK;
 
-    if(m_bCalibrating)
-        return nErr;
+    if(m_bLinkDown) {
+        if(!m_bPortReopened || resumeLink())
+            return ERR_COMMNOLINK;
+    }
 
-    nErr = domeCommand("g#", sResp, 'g');
-    if(nErr) {
+    std::lock_guard<std::recursive_mutex> lock(m_DevMutex);
+
+    for(i = 0; i < svCmds.size(); i++)
+        sCmds += svCmds[i];
+
+    m_pSerx->purgeTxRx();
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [domeCommands] Sending : " << sCmds << std::endl;
+    m_sLogFile.flush();
+#endif
+    nErr = m_pSerx->writeFile((void *)(sCmds.c_str()), sCmds.size(), ulBytesWrite);
+    m_pSerx->flushTx();
+    if(nErr){
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getDomeAz] ERROR = " << sResp << std::endl;
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [domeCommands] writeFile error : " << nErr << std::endl;
         m_sLogFile.flush();
 #endif
+        checkLink(nErr);
         return nErr;
     }
-    // convert Az string to double
-    try {
-        dDomeAz = std::stof(sResp);
+
+    // readResponse always stops on a '#' but can return more than one response.
+    while(svRawResps.size() < svCmds.size()) {
+        nErr = readResponse(localResp, nTimeout);
+        checkLink(nErr);
+        if(nErr)
+            return nErr;
+        if(parseFields(localResp, svFields, '#'))
+            continue;
+        svRawResps.insert(svRawResps.end(), svFields.begin(), svFields.end());
     }
-    catch(const std::exception& e) {
+
+    for(i = 0; i < svCmds.size(); i++) {
+        if(svRawResps[i].size() && svCmds[i].size() && svRawResps[i].at(0) == svCmds[i].at(0))
+            svResps.push_back(svRawResps[i].substr(1));
+        else
+            svResps.push_back("");
+    }
+
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getDomeAz] convertsion exception = " << e.what() << std::endl;
-        m_sLogFile.flush();
+    for(i = 0; i < svResps.size(); i++)
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [domeCommands] response " << svCmds[i] << " : " << svResps[i] << std::endl;
+    m_sLogFile.flush();
 #endif
-        dDomeAz = 0;
+    return nErr;
+}
+
+int CRTIDome::getDomeAz(double &dDomeAz)
+{
+    int nErr = PLUGIN_OK;
+    std::string sResp;
+    int nDirection;
+    int nHomeStatus;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_bCalibrating)
+        return nErr;
+
+    if(m_bBinaryMode) {
+        nErr = getBinaryStatus(dDomeAz, nDirection, nHomeStatus);
+        if(nErr)
+            return nErr;
+    }
+    else {
+        nErr = domeCommand("g#", sResp, 'g');
+        if(nErr) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getDomeAz] ERROR = " << sResp << std::endl;
+            m_sLogFile.flush();
+#endif
+            return nErr;
+        }
+        // convert Az string to double
+        try {
+            dDomeAz = std::stof(sResp);
+        }
+        catch(const std::exception& e) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getDomeAz] convertsion exception = " << e.what() << std::endl;
+            m_sLogFile.flush();
+#endif
+            dDomeAz = 0;
+        }
     }
 
     m_dCurrentAzPosition = dDomeAz;
+    updateMoveModel(dDomeAz);
 
     if(m_cRainCheckTimer.GetElapsedSeconds() > RAIN_CHECK_INTERVAL) {
         writeRainStatus();
@@ -578,6 +1232,7 @@ int CRTIDome::setDomeStepPerRev(int nStepPerRev)
     std::stringstream ssTmp;
 
     m_nNbStepPerRev = nStepPerRev;
+    stopMoveModel();
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
@@ -746,11 +1401,16 @@ bool CRTIDome::isDomeMoving()
     int nTmp;
     int nErr = PLUGIN_OK;
     std::string sResp;
+    double dDomeAz;
+    int nHomeStatus;
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
-    nErr = domeCommand("m#", sResp, 'm');
+    if(m_bBinaryMode)
+        nErr = getBinaryStatus(dDomeAz, nTmp, nHomeStatus);
+    else
+        nErr = domeCommand("m#", sResp, 'm');
     if(nErr & !m_bCalibrating) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
         m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isDomeMoving] ERROR = " << sResp << std::endl;
@@ -763,15 +1423,17 @@ bool CRTIDome::isDomeMoving()
     }
 
     bIsMoving = false;
-    try {
-        nTmp = std::stoi(sResp);
-    }
-    catch(const std::exception& e) {
+    if(!m_bBinaryMode) {
+        try {
+            nTmp = std::stoi(sResp);
+        }
+        catch(const std::exception& e) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isDomeMoving] convertsion exception = " << e.what() << std::endl;
-        m_sLogFile.flush();
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isDomeMoving] convertsion exception = " << e.what() << std::endl;
+            m_sLogFile.flush();
 #endif
-        nTmp = MOVE_NONE;
+            nTmp = MOVE_NONE;
+        }
     }
 #ifdef PLUGIN_DEBUG
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isDomeMoving] nTmp : " << nTmp << std::endl;
@@ -794,11 +1456,16 @@ bool CRTIDome::isDomeAtHome()
     int nTmp;
     int nErr = PLUGIN_OK;
     std::string sResp;
+    double dDomeAz;
+    int nDirection;
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
-    nErr = domeCommand("z#", sResp, 'z');
+    if(m_bBinaryMode)
+        nErr = getBinaryStatus(dDomeAz, nDirection, nTmp);
+    else
+        nErr = domeCommand("z#", sResp, 'z');
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isDomeAtHome] response = " << sResp << std::endl;
     m_sLogFile.flush();
@@ -808,15 +1475,17 @@ bool CRTIDome::isDomeAtHome()
     }
 
     bAthome = false;
-    try {
-        nTmp = std::stoi(sResp);
-    }
-    catch(const std::exception& e) {
+    if(!m_bBinaryMode) {
+        try {
+            nTmp = std::stoi(sResp);
+        }
+        catch(const std::exception& e) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isDomeAtHome] convertsion exception = " << e.what() << std::endl;
-        m_sLogFile.flush();
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isDomeAtHome] convertsion exception = " << e.what() << std::endl;
+            m_sLogFile.flush();
 #endif
-        nTmp = ATHOME;
+            nTmp = ATHOME;
+        }
     }
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isDomeAtHome] nTmp : " << nTmp << std::endl;
@@ -842,6 +1511,9 @@ int CRTIDome::syncDome(double dAz, double dEl)
         return NOT_CONNECTED;
 
     m_dCurrentAzPosition = dAz;
+    stopMoveModel();
+    m_bGotoInProgress = false;
+    m_bPendingGoto = false;
     ssTmp << "s" << std::fixed << std::setprecision(2) << dAz << "#";
     nErr = domeCommand(ssTmp.str(), sResp, 's');
     if(nErr) {
@@ -863,9 +1535,20 @@ int CRTIDome::parkDome()
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
+    m_bGotoInProgress = false;
+    m_bPendingGoto = false;
     if(m_bHomeOnPark) {
         m_bParking = true;
-        nErr = goHome();
+        if(m_fVersion >= WAYPOINTS_MIN_VERSION && !m_bCalibrating) {
+            std::stringstream ssTmp;
+            ssTmp << "H,G" << std::fixed << std::setprecision(2) << m_dParkAz;
+            stopMoveModel();
+            nErr = startWaypoints(ssTmp.str());
+            if(nErr)
+                nErr = goHome();
+        }
+        else
+            nErr = goHome();
     } else
         nErr = gotoAzimuth(m_dParkAz);
 
@@ -877,7 +1560,13 @@ int CRTIDome::unparkDome()
 {
     if(m_bHomeOnUnpark) {
         m_bUnParking = true;
-        goHome();
+        if(m_fVersion >= WAYPOINTS_MIN_VERSION && !m_bCalibrating) {
+            stopMoveModel();
+            if(startWaypoints("H"))
+                goHome();
+        }
+        else
+            goHome();
     }
     else {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
@@ -892,6 +1581,90 @@ int CRTIDome::unparkDome()
     return 0;
 }
 
+int CRTIDome::startWaypoints(const std::string &sSegments)
+{
+    int nErr = PLUGIN_OK;
+    std::string sResp;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [startWaypoints] sSegments = " << sSegments << std::endl;
+    m_sLogFile.flush();
+#endif
+
+    m_bWaypoints = false;
+    nErr = domeCommand("W" + sSegments + "#", sResp, 'W');
+    if(nErr)
+        return nErr;
+
+    if(sResp.size() && sResp.at(0) == 'E') {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [startWaypoints] waypoints refused" << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+    m_bWaypoints = true;
+    return nErr;
+}
+
+int CRTIDome::getWaypointStatus(int &nStatus)
+{
+    int nErr = PLUGIN_OK;
+    std::string sResp;
+    std::vector<std::string> svFields;
+
+    nStatus = WAYPOINTS_IDLE;
+    nErr = domeCommand("W#", sResp, 'W');
+    if(nErr)
+        return nErr;
+
+    nErr = parseFields(sResp, svFields, ',');
+    if(nErr || !svFields.size())
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+
+    try {
+        nStatus = std::stoi(svFields[0]);
+    }
+    catch(const std::exception& e) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getWaypointStatus] convertsion exception = " << e.what() << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getWaypointStatus] sResp = " << sResp << std::endl;
+    m_sLogFile.flush();
+#endif
+    return nErr;
+}
+
+// one poll for the whole queue, the firmware does the homing, sync and goto back to back
+int CRTIDome::checkWaypoints(bool &bComplete)
+{
+    int nErr = PLUGIN_OK;
+    int nStatus;
+
+    bComplete = false;
+    nErr = getWaypointStatus(nStatus);
+    if(nErr)
+        return nErr;
+
+    if(nStatus == WAYPOINTS_RUNNING)
+        return nErr;
+
+    m_bWaypoints = false;
+    if(nStatus == WAYPOINTS_CANCELLED)
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+
+    bComplete = true;
+    return nErr;
+}
+
 int CRTIDome::gotoAzimuth(double dNewAz)
 {
     int nErr = PLUGIN_OK;
@@ -926,9 +1699,86 @@ int CRTIDome::gotoAzimuth(double dNewAz)
     }
 
     m_dGotoAz = dNewAz;
+    m_bGotoSuppressed = false;
+    startMoveModel(dNewAz);
+    return nErr;
+}
+
+// goto used when slaving, dNewAz and dNewEl are where the telescope is pointing.
+// skip the moves that would not change what the telescope sees through the slit.
+int CRTIDome::slewToAzimuth(double dNewAz, double dNewEl)
+{
+    int nErr = PLUGIN_OK;
+    double dWindow;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_DomeGeometry.isEnabled()) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [slewToAzimuth] telescope Az = " << std::fixed << std::setprecision(2) << dNewAz << ", El = " << dNewEl << ", dome Az = " << m_DomeGeometry.getDomeAz(dNewAz, dNewEl) << std::endl;
+        m_sLogFile.flush();
+#endif
+        dNewAz = m_DomeGeometry.getDomeAz(dNewAz, dNewEl);
+    }
+
+    dWindow = m_dSlitWidth/2 - m_dSlitHysteresis;
+    if(dWindow <= 0)
+        return gotoAzimuth(dNewAz);
+
+    while(dNewAz >= 360)
+        dNewAz = dNewAz - 360;
+    while(dNewAz < 0)
+        dNewAz = dNewAz + 360;
+
+    if(m_bGotoInProgress) {
+        // we'll end up at m_dGotoAz, only keep the last target if that's not good enough.
+        if(m_bPendingGoto)
+            m_nAvoidedGotos++;
+        if(fabs(getAngularDistance(m_dGotoAz, dNewAz)) < dWindow) {
+            if(!m_bPendingGoto)
+                m_nAvoidedGotos++;
+            m_bPendingGoto = false;
+        }
+        else {
+            m_dPendingGotoAz = dNewAz;
+            m_bPendingGoto = true;
+        }
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [slewToAzimuth] goto in progress, dNewAz = " << std::fixed << std::setprecision(2) << dNewAz << ", m_bPendingGoto = " << (m_bPendingGoto?"True":"False") << ", m_nAvoidedGotos = " << m_nAvoidedGotos << std::endl;
+        m_sLogFile.flush();
+#endif
+        return nErr;
+    }
+
+    if(fabs(getAngularDistance(getCurrentAz(), dNewAz)) < dWindow) {
+        m_nAvoidedGotos++;
+        m_bGotoSuppressed = true;
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [slewToAzimuth] dNewAz = " << std::fixed << std::setprecision(2) << dNewAz << " is still in the slit, m_nAvoidedGotos = " << m_nAvoidedGotos << std::endl;
+        m_sLogFile.flush();
+#endif
+        return nErr;
+    }
+
+    nErr = gotoAzimuth(dNewAz);
+    if(!nErr)
+        m_bGotoInProgress = true;
     return nErr;
 }
 
+void CRTIDome::setSlitWidth(double dWidth, double dHysteresis)
+{
+    m_dSlitWidth = dWidth;
+    m_dSlitHysteresis = dHysteresis;
+}
+
+void CRTIDome::setDomeGeometry(double dLatitude, double dDomeRadius, double dMountEast, double dMountNorth, double dMountUp, double dGemArm, double dFlipHA)
+{
+    m_DomeGeometry.setGeometry(dLatitude, dDomeRadius, dMountEast, dMountNorth, dMountUp, dGemArm);
+    m_DomeGeometry.setFlipHourAngle(dFlipHA);
+}
+
 int CRTIDome::openShutter()
 {
     int nErr = PLUGIN_OK;
@@ -1036,17 +1886,337 @@ int CRTIDome::closeShutter()
         nErr = MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_BATTERY_LOW);
     }
 
-    return nErr;
+    return nErr;
+}
+
+// sFingerprint is "version,MAC,config CRC", it changes if anything we cache changes on the controller.
+// Firmware FINGERPRINT_STATE_MIN_VERSION and up add the azimuth and home status and, with bBinaryFrames, switch to binary frames.
+int CRTIDome::getFingerprint(std::string &sFingerprint, bool &bShutterPresent, int &nShutterState, double &dDomeAz, bool bBinaryFrames)
+{
+    int nErr = PLUGIN_OK;
+    std::string sResp;
+    std::string sVersion;
+    float fVersion;
+    std::vector<std::string> svFields;
+
+    sFingerprint.clear();
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    nErr = domeCommand(bBinaryFrames ? "A1#" : "A#", sResp, 'A');
+    if(nErr) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getFingerprint] ERROR = " << nErr << " , firmware without fingerprint ?" << std::endl;
+        m_sLogFile.flush();
+#endif
+        return nErr;
+    }
+
+    nErr = parseFields(sResp, svFields, ',');
+    if(nErr || svFields.size() < 5)
+        return BAD_CMD_RESPONSE;
+
+    try {
+        nShutterState = std::stoi(svFields[4]);
+    }
+    catch(const std::exception& e) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getFingerprint] convertsion exception = " << e.what() << std::endl;
+        m_sLogFile.flush();
+#endif
+        nShutterState = SHUTTER_ERROR;
+    }
+    bShutterPresent = (svFields[3] == "1");
+    sFingerprint = svFields[0] + "," + svFields[1] + "," + svFields[2];
+
+    parseFirmwareVersion(svFields[0], sVersion, fVersion);
+    if(fVersion < FINGERPRINT_STATE_MIN_VERSION || svFields.size() < 7)
+        return nErr;
+    // the reply went out in ASCII, everything after it is in binary frames
+    if(bBinaryFrames)
+        m_bBinaryMode = true;
+    try {
+        dDomeAz = std::stof(svFields[5]);
+    }
+    catch(const std::exception& e) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getFingerprint] convertsion exception = " << e.what() << std::endl;
+        m_sLogFile.flush();
+#endif
+        dDomeAz = m_dParkAz;
+    }
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getFingerprint] dDomeAz = " << dDomeAz << " , home status = " << svFields[6] << " , m_bBinaryMode = " << (m_bBinaryMode?"Yes":"No") << std::endl;
+    m_sLogFile.flush();
+#endif
+    return nErr;
+}
+
+// version saved with the profile of this port, 0 if we never connected to it
+float CRTIDome::getCachedFirmwareVersion()
+{
+    std::ifstream profileFile;
+    std::string sLine;
+    std::string sVersion;
+    std::vector<std::string> svFields;
+    float fVersion = 0.0;
+
+    profileFile.open(m_sProfilefilePath, std::ios::in);
+    if(!profileFile.is_open())
+        return fVersion;
+
+    while(std::getline(profileFile, sLine)) {
+        if(parseFields(sLine, svFields, ';') || svFields.size() < 12 || svFields[0] != m_Port)
+            continue;
+        parseFirmwareVersion(svFields[6], sVersion, fVersion);
+        break;
+    }
+    profileFile.close();
+    return fVersion;
+}
+
+// one line per port : port;fingerprint;ip;subnet;gateway;dhcp;version;park az;home az;steps per rev;speed;acceleration
+bool CRTIDome::loadProfile(const std::string &sFingerprint)
+{
+    std::ifstream profileFile;
+    std::string sLine;
+    std::vector<std::string> svFields;
+    bool bFound = false;
+
+    profileFile.open(m_sProfilefilePath, std::ios::in);
+    if(!profileFile.is_open())
+        return false;
+
+    while(!bFound && std::getline(profileFile, sLine)) {
+        if(parseFields(sLine, svFields, ';') || svFields.size() < 12)
+            continue;
+        if(svFields[0] != m_Port || svFields[1] != sFingerprint)
+            continue;
+        try {
+            m_IpAddress = svFields[2];
+            m_SubnetMask = svFields[3];
+            m_GatewayIP = svFields[4];
+            m_bUseDHCP = (svFields[5] == "1");
+            parseFirmwareVersion(svFields[6], m_sFirmwareVersion, m_fVersion);
+            m_dParkAz = std::stof(svFields[7]);
+            m_dHomeAz = std::stof(svFields[8]);
+            m_nNbStepPerRev = std::stoi(svFields[9]);
+            m_nRotationSpeed = std::stoi(svFields[10]);
+            m_nRotationAcceleration = std::stoi(svFields[11]);
+            bFound = true;
+        }
+        catch(const std::exception& e) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [loadProfile] convertsion exception = " << e.what() << std::endl;
+            m_sLogFile.flush();
+#endif
+        }
+    }
+    profileFile.close();
+    return bFound;
+}
+
+void CRTIDome::saveProfile(const std::string &sFingerprint)
+{
+    std::ifstream profileFile;
+    std::ofstream newProfileFile;
+    std::string sLine;
+    std::vector<std::string> svLines;
+    std::stringstream ssProfile;
+    size_t i;
+
+    ssProfile << m_Port << ";" << sFingerprint << ";" << m_IpAddress << ";" << m_SubnetMask << ";" << m_GatewayIP << ";" << (m_bUseDHCP?"1":"0") << ";"
+              << m_sFirmwareVersion << ";" << std::fixed << std::setprecision(2) << m_dParkAz << ";" << m_dHomeAz << ";"
+              << m_nNbStepPerRev << ";" << m_nRotationSpeed << ";" << m_nRotationAcceleration;
+
+    // keep the other ports
+    profileFile.open(m_sProfilefilePath, std::ios::in);
+    if(profileFile.is_open()) {
+        while(std::getline(profileFile, sLine)) {
+            if(sLine.size() && sLine.compare(0, m_Port.size()+1, m_Port + ";") != 0)
+                svLines.push_back(sLine);
+        }
+        profileFile.close();
+    }
+    svLines.push_back(ssProfile.str());
+
+    newProfileFile.open(m_sProfilefilePath, std::ios::out |std::ios::trunc);
+    if(!newProfileFile.is_open()) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [saveProfile] Error writing " << m_sProfilefilePath << std::endl;
+        m_sLogFile.flush();
+#endif
+        return;
+    }
+    for(i = 0; i < svLines.size(); i++)
+        newProfileFile << svLines[i] << std::endl;
+    newProfileFile.close();
+}
+
+#pragma mark - configuration backup
+
+// hex blob from the X and Z commands : version, kind, tag/size/value records, CRC16 (big endian).
+// We only check the CRC, the firmware knows what's in it.
+static bool isConfigBlobValid(const std::string &sHex)
+{
+    std::vector<uint8_t> data;
+    size_t i;
+
+    if(sHex.size() < 8 || sHex.size() & 1 || sHex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+        return false;
+    for(i = 0; i < sHex.size(); i += 2)
+        data.push_back((uint8_t)std::stoi(sHex.substr(i, 2), nullptr, 16));
+    return crc16(data.data(), data.size() - 2) == (((uint16_t)data[data.size() - 2] << 8) | data[data.size() - 1]);
+}
+
+// one line per port : port;rotator blob;shutter blob
+int CRTIDome::backupConfig()
+{
+    int nErr = PLUGIN_OK;
+    std::ifstream backupFile;
+    std::ofstream newBackupFile;
+    std::string sLine;
+    std::vector<std::string> svLines;
+    std::string sRotatorBlob;
+    std::string sShutterBlob;
+    size_t i;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_fVersion < CONFIG_BLOB_MIN_VERSION)
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+
+    nErr = domeCommand("X#", sRotatorBlob, 'X');
+    if(nErr)
+        return nErr;
+    if(!isConfigBlobValid(sRotatorBlob)) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [backupConfig] bad rotator blob " << sRotatorBlob << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    if(m_bShutterPresent && m_fShutterVersion >= SHUTTER_CONFIG_BLOB_MIN_VERSION) {
+        nErr = domeCommand("Z#", sShutterBlob, 'Z');
+        if(nErr)
+            return nErr;
+        if(!isConfigBlobValid(sShutterBlob)) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [backupConfig] bad shutter blob " << sShutterBlob << std::endl;
+            m_sLogFile.flush();
+#endif
+            return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+        }
+    }
+
+    // keep the other ports
+    backupFile.open(m_sConfigBackupfilePath, std::ios::in);
+    if(backupFile.is_open()) {
+        while(std::getline(backupFile, sLine)) {
+            if(sLine.size() && sLine.compare(0, m_Port.size()+1, m_Port + ";") != 0)
+                svLines.push_back(sLine);
+        }
+        backupFile.close();
+    }
+    svLines.push_back(m_Port + ";" + sRotatorBlob + ";" + sShutterBlob);
+
+    newBackupFile.open(m_sConfigBackupfilePath, std::ios::out |std::ios::trunc);
+    if(!newBackupFile.is_open()) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [backupConfig] Error writing " << m_sConfigBackupfilePath << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+    for(i = 0; i < svLines.size(); i++)
+        newBackupFile << svLines[i] << std::endl;
+    newBackupFile.close();
+
+    return nErr;
+}
+
+// The firmwares check the blobs and refuse them as a whole (XE/ZE), settings missing from an older blob keep their value.
+int CRTIDome::restoreConfig()
+{
+    int nErr = PLUGIN_OK;
+    std::ifstream backupFile;
+    std::string sLine;
+    std::vector<std::string> svFields;
+    std::string sResp;
+    bool bFound = false;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_fVersion < CONFIG_BLOB_MIN_VERSION)
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+
+    backupFile.open(m_sConfigBackupfilePath, std::ios::in);
+    if(!backupFile.is_open())
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    while(!bFound && std::getline(backupFile, sLine)) {
+        if(parseFields(sLine, svFields, ';') || svFields.size() < 2)
+            continue;
+        bFound = (svFields[0] == m_Port);
+    }
+    backupFile.close();
+
+    if(!bFound || !isConfigBlobValid(svFields[1])) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [restoreConfig] no valid backup for " << m_Port << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    nErr = domeCommand("X" + svFields[1] + "#", sResp, 'X');
+    if(nErr)
+        return nErr;
+    if(sResp.size() && sResp.at(0) == 'E') {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [restoreConfig] rotator refused the configuration" << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    // refresh what we keep locally
+    stopMoveModel();
+    getDomeStepPerRev(m_nNbStepPerRev);
+    getDomeHomeAz(m_dHomeAz);
+    getDomeParkAz(m_dParkAz);
+    getRotationSpeed(m_nRotationSpeed);
+    getRotationAcceleration(m_nRotationAcceleration);
+
+    if(svFields.size() > 2 && svFields[2].size() && m_bShutterPresent && m_fShutterVersion >= SHUTTER_CONFIG_BLOB_MIN_VERSION) {
+        if(!isConfigBlobValid(svFields[2]))
+            return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+        nErr = domeCommand("Z" + svFields[2] + "#", sResp, 'Z');
+        if(nErr)
+            return nErr;
+        if(sResp.size() && (sResp.at(0) == 'E' || sResp.at(0) == 'U')) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [restoreConfig] shutter refused the configuration" << std::endl;
+            m_sLogFile.flush();
+#endif
+            return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+        }
+        sendShutterHello(); // so the rotator gets the new shutter values
+    }
+    return nErr;
+}
+
+void CRTIDome::getConfigBackupFileName(std::string &fName)
+{
+    fName.assign(m_sConfigBackupfilePath);
 }
 
 int CRTIDome::getFirmwareVersion(std::string &sVersion, float &fVersion)
 {
     int nErr = PLUGIN_OK;
-    int i;
     std::string sResp;
-    std::vector<std::string> firmwareFields;
-    std::vector<std::string> versionFields;
-    std::string strVersion;
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
@@ -1069,6 +2239,17 @@ int CRTIDome::getFirmwareVersion(std::string &sVersion, float &fVersion)
     m_sLogFile.flush();
 #endif
 
+    return parseFirmwareVersion(sResp, sVersion, fVersion);
+}
+
+int CRTIDome::parseFirmwareVersion(const std::string sResp, std::string &sVersion, float &fVersion)
+{
+    int nErr = PLUGIN_OK;
+    int i;
+    std::vector<std::string> firmwareFields;
+    std::vector<std::string> versionFields;
+    std::string strVersion;
+
     nErr = parseFields(sResp,firmwareFields, 'v');
     if(nErr) {
         sVersion = "N/A";
@@ -1077,8 +2258,8 @@ int CRTIDome::getFirmwareVersion(std::string &sVersion, float &fVersion)
     }
     if(!firmwareFields.size()) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getFirmwareVersion] firmwareFields is empty" << std::endl;
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getFirmwareVersion] response len = " << sResp.size() << std::endl;
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseFirmwareVersion] firmwareFields is empty" << std::endl;
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseFirmwareVersion] response len = " << sResp.size() << std::endl;
         m_sLogFile.flush();
 #endif
         return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
@@ -1097,7 +2278,7 @@ int CRTIDome::getFirmwareVersion(std::string &sVersion, float &fVersion)
             }
             catch(const std::exception& e) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-                m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getFirmwareVersion] convertsion exception = " << e.what() << std::endl;
+                m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseFirmwareVersion] convertsion exception = " << e.what() << std::endl;
                 m_sLogFile.flush();
 #endif
                 fVersion = 0;
@@ -1193,9 +2374,17 @@ int CRTIDome::goHome()
 #ifdef PLUGIN_DEBUG
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [goHome]" << std::endl;
     m_sLogFile.flush();
+    int nCrossings, nLastSlip, nMaxSlip, nTotalCorrection, nRejected;
+    if(getSlipStats(nCrossings, nLastSlip, nMaxSlip, nTotalCorrection, nRejected) == PLUGIN_OK) {
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [goHome] slip since last homing : " << nCrossings << " home crossings, last " << nLastSlip << " steps, largest " << nMaxSlip << " steps, total correction " << nTotalCorrection << " steps, " << nRejected << " rejected" << std::endl;
+        m_sLogFile.flush();
+    }
 #endif
 
     m_nHomingTries = 0;
+    stopMoveModel();
+    m_bGotoInProgress = false;
+    m_bPendingGoto = false;
     nErr = domeCommand("h#", sResp, 'h');
     if(nErr) {
 #ifdef PLUGIN_DEBUG
@@ -1217,6 +2406,9 @@ int CRTIDome::calibrate()
         return NOT_CONNECTED;
 
 
+    stopMoveModel();
+    m_bGotoInProgress = false;
+    m_bPendingGoto = false;
     nErr = domeCommand("c#", sResp, 'c');
     if(nErr) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
@@ -1238,6 +2430,12 @@ int CRTIDome::isGoToComplete(bool &bComplete)
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
+    if(m_bGotoSuppressed) {
+        // we didn't move
+        bComplete = true;
+        return nErr;
+    }
+
     bComplete = false;
     if(isDomeMoving()) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
@@ -1248,6 +2446,7 @@ int CRTIDome::isGoToComplete(bool &bComplete)
         return nErr;
     }
 
+    stopMoveModel();
     getDomeAz(dDomeAz);
 
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
@@ -1259,6 +2458,17 @@ int CRTIDome::isGoToComplete(bool &bComplete)
     if(checkBoundaries(m_dGotoAz, dDomeAz)) {
         bComplete = true;
         m_nGotoTries = 0;
+        updateGotoTimeCorrection();
+        if(m_bPendingGoto) {
+            // a new target came in while we were moving
+            m_bPendingGoto = false;
+            bComplete = false;
+            nErr = gotoAzimuth(m_dPendingGotoAz);
+            if(nErr)
+                m_bGotoInProgress = false;
+        }
+        else
+            m_bGotoInProgress = false;
     }
     else {
         // we're not moving and we're not at the final destination !!!
@@ -1279,6 +2489,8 @@ int CRTIDome::isGoToComplete(bool &bComplete)
             m_sLogFile.flush();
 #endif
             m_nGotoTries = 0;
+            m_bGotoInProgress = false;
+            m_bPendingGoto = false;
             nErr = ERR_CMDFAILED;
         }
     }
@@ -1297,8 +2509,15 @@ bool CRTIDome::checkBoundaries(double dGotoAz, double dDomeAz)
     double highMark;
     double lowMark;
     double roundedGotoAz;
+    double dTolerance;
+
+    if(m_nNbStepPerRev > 0) {
+        // the firmware truncates the move to a multiple of DOME_STEP_TYPE steps and we get the position with 2 decimals.
+        dTolerance = (DOME_STEP_TYPE + 1) * 360.0 / m_nNbStepPerRev + 0.01;
+        return fabs(getAngularDistance(dDomeAz, dGotoAz)) <= dTolerance;
+    }
 
-    // we need to test "large" depending on the heading error and movement coasting
+    // we don't know the step resolution, we need to test "large" depending on the heading error and movement coasting
     highMark = ceil(dDomeAz)+2;
     lowMark = ceil(dDomeAz)-2;
     roundedGotoAz = ceil(dGotoAz);
@@ -1322,6 +2541,234 @@ bool CRTIDome::checkBoundaries(double dGotoAz, double dDomeAz)
     return false;
 }
 
+double CRTIDome::getAngularDistance(double dFromAz, double dToAz)
+{
+    double dDelta;
+
+    // same shortest path logic as the firmware
+    dDelta = dToAz - dFromAz;
+    if (dDelta > 180)
+        dDelta -= 360;
+    if (dDelta < -180)
+        dDelta += 360;
+
+    return dDelta;
+}
+
+#pragma mark - move model
+
+void CRTIDome::startMoveModel(double dGotoAz)
+{
+    double dDelta;
+
+    m_bMoveModelActive = false;
+    if(m_nNbStepPerRev <= 0 || m_nRotationSpeed <= 0 || m_nRotationAcceleration <= 0)
+        return; // we don't know enough about the motor, use the controller position.
+
+    dDelta = getAngularDistance(m_dCurrentAzPosition, dGotoAz);
+    if(dDelta == 0)
+        return;
+
+    m_dMoveTargetAz = dGotoAz;
+    m_nMoveDirection = dDelta > 0 ? MOVE_POSITIVE : MOVE_NEGATIVE;
+    m_dMoveSteps = fabs(dDelta) * m_nNbStepPerRev / 360.0;
+    m_dMoveTimeOffset = 0;
+    m_MoveTimer.Reset();
+    m_AzRefreshTimer.Reset();
+    m_bMoveModelActive = true;
+
+    m_dGotoPredictedTime = getMoveDuration(m_dMoveSteps);
+    m_GotoTimer.Reset();
+    m_bTimingGoto = true;
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [startMoveModel] from " << std::fixed << std::setprecision(2) << m_dCurrentAzPosition << " to " << dGotoAz << ", " << m_dMoveSteps << " steps in " << m_dGotoPredictedTime << " s" << std::endl;
+    m_sLogFile.flush();
+#endif
+}
+
+void CRTIDome::stopMoveModel()
+{
+    m_bMoveModelActive = false;
+}
+
+// resync the model to a position read from the controller
+void CRTIDome::updateMoveModel(double dDomeAz)
+{
+    double dStepsLeft;
+
+    if(!m_bMoveModelActive)
+        return;
+
+    dStepsLeft = getAngularDistance(dDomeAz, m_dMoveTargetAz) * m_nMoveDirection * m_nNbStepPerRev / 360.0;
+    if(dStepsLeft > m_dMoveSteps)
+        dStepsLeft = m_dMoveSteps; // not started yet
+    if(dStepsLeft < 1) {
+        // we're there (or we overshot), the controller knows better than the model from now on
+        stopMoveModel();
+        return;
+    }
+    m_dMoveTimeOffset = getMoveTimeAt(m_dMoveSteps, m_dMoveSteps - dStepsLeft);
+    m_MoveTimer.Reset();
+    m_AzRefreshTimer.Reset();
+}
+
+double CRTIDome::getMoveModelAz()
+{
+    double dStepsLeft;
+    double dAz;
+
+    dStepsLeft = m_dMoveSteps - getMoveStepsAt(m_dMoveSteps, m_dMoveTimeOffset + m_MoveTimer.GetElapsedSeconds());
+    dAz = m_dMoveTargetAz - (dStepsLeft * 360.0 / m_nNbStepPerRev) * m_nMoveDirection;
+    while(dAz < 0)
+        dAz += 360;
+    while(dAz >= 360)
+        dAz -= 360;
+    return dAz;
+}
+
+// trapezoidal profile, same as AccelStepper : accelerate, cruise at max speed, decelerate.
+// short moves never reach max speed and have no cruise part.
+void CRTIDome::getMoveProfile(double dSteps, double &dAccelTime, double &dCruiseTime, double &dPeakSpeed)
+{
+    double dAccelSteps;
+
+    dPeakSpeed = m_nRotationSpeed;
+    dAccelTime = dPeakSpeed / m_nRotationAcceleration;
+    dAccelSteps = 0.5 * m_nRotationAcceleration * dAccelTime * dAccelTime;
+    if(2 * dAccelSteps >= dSteps) {
+        dPeakSpeed = sqrt(m_nRotationAcceleration * dSteps);
+        dAccelTime = dPeakSpeed / m_nRotationAcceleration;
+        dCruiseTime = 0;
+    }
+    else {
+        dCruiseTime = (dSteps - 2 * dAccelSteps) / dPeakSpeed;
+    }
+}
+
+// number of steps done after dTime seconds for a move of dSteps
+double CRTIDome::getMoveStepsAt(double dSteps, double dTime)
+{
+    double dAccelTime, dCruiseTime, dPeakSpeed;
+    double dTimeLeft;
+
+    getMoveProfile(dSteps, dAccelTime, dCruiseTime, dPeakSpeed);
+    if(dTime <= 0)
+        return 0;
+    if(dTime < dAccelTime)
+        return 0.5 * m_nRotationAcceleration * dTime * dTime;
+    if(dTime < dAccelTime + dCruiseTime)
+        return 0.5 * dPeakSpeed * dAccelTime + dPeakSpeed * (dTime - dAccelTime);
+    dTimeLeft = 2 * dAccelTime + dCruiseTime - dTime;
+    if(dTimeLeft <= 0)
+        return dSteps;
+    return dSteps - 0.5 * m_nRotationAcceleration * dTimeLeft * dTimeLeft;
+}
+
+double CRTIDome::getMoveDuration(double dSteps)
+{
+    double dAccelTime, dCruiseTime, dPeakSpeed;
+
+    getMoveProfile(dSteps, dAccelTime, dCruiseTime, dPeakSpeed);
+    return 2 * dAccelTime + dCruiseTime;
+}
+
+// inverse of getMoveStepsAt
+double CRTIDome::getMoveTimeAt(double dSteps, double dStepsDone)
+{
+    double dAccelTime, dCruiseTime, dPeakSpeed;
+    double dAccelSteps;
+
+    getMoveProfile(dSteps, dAccelTime, dCruiseTime, dPeakSpeed);
+    dAccelSteps = 0.5 * dPeakSpeed * dAccelTime;
+    if(dStepsDone <= 0)
+        return 0;
+    if(dStepsDone < dAccelSteps)
+        return sqrt(2 * dStepsDone / m_nRotationAcceleration);
+    if(dStepsDone < dSteps - dAccelSteps)
+        return dAccelTime + (dStepsDone - dAccelSteps) / dPeakSpeed;
+    if(dStepsDone >= dSteps)
+        return 2 * dAccelTime + dCruiseTime;
+    return 2 * dAccelTime + dCruiseTime - sqrt(2 * (dSteps - dStepsDone) / m_nRotationAcceleration);
+}
+
+#pragma mark - goto time estimates
+
+int CRTIDome::getGotoETA(double dAz, double &dSeconds)
+{
+    double dSteps;
+
+    dSeconds = 0;
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_nNbStepPerRev <= 0 || m_nRotationSpeed <= 0 || m_nRotationAcceleration <= 0)
+        return ERR_CMDFAILED;
+
+    while(dAz >= 360)
+        dAz = dAz - 360;
+    while(dAz < 0)
+        dAz = dAz + 360;
+
+    // the firmware always takes the shortest path
+    dSteps = fabs(getAngularDistance(getCurrentAz(), dAz)) * m_nNbStepPerRev / 360.0;
+    dSeconds = getMoveDuration(dSteps) * m_dGotoTimeCorrection;
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getGotoETA] dAz = " << std::fixed << std::setprecision(2) << dAz << ", dSeconds = " << dSeconds << std::endl;
+    m_sLogFile.flush();
+#endif
+    return PLUGIN_OK;
+}
+
+int CRTIDome::getGotoTimeLeft(double &dSeconds)
+{
+    dSeconds = 0;
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(!m_bTimingGoto)
+        return PLUGIN_OK;
+
+    dSeconds = m_dGotoPredictedTime * m_dGotoTimeCorrection - m_GotoTimer.GetElapsedSeconds();
+    if(dSeconds < 0)
+        dSeconds = 0;
+    return PLUGIN_OK;
+}
+
+void CRTIDome::setGotoTimeCorrection(double dCorrection)
+{
+    if(dCorrection < GOTO_ETA_MIN_CORRECTION || dCorrection > GOTO_ETA_MAX_CORRECTION)
+        dCorrection = 1.0;
+    m_dGotoTimeCorrection = dCorrection;
+}
+
+// learn how far off the motion model is on this dome (motor start delay, polling, ...)
+void CRTIDome::updateGotoTimeCorrection()
+{
+    double dRatio;
+
+    if(!m_bTimingGoto)
+        return;
+    m_bTimingGoto = false;
+
+    // very short moves are dominated by the polling rate, don't learn from them
+    if(m_dGotoPredictedTime < 1.0)
+        return;
+
+    dRatio = m_GotoTimer.GetElapsedSeconds() / m_dGotoPredictedTime;
+    if(dRatio < GOTO_ETA_MIN_CORRECTION)
+        dRatio = GOTO_ETA_MIN_CORRECTION;
+    if(dRatio > GOTO_ETA_MAX_CORRECTION)
+        dRatio = GOTO_ETA_MAX_CORRECTION;
+    m_dGotoTimeCorrection = m_dGotoTimeCorrection * (1.0 - GOTO_ETA_FILTER) + dRatio * GOTO_ETA_FILTER;
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [updateGotoTimeCorrection] predicted = " << std::fixed << std::setprecision(2) << m_dGotoPredictedTime << ", ratio = " << dRatio << ", m_dGotoTimeCorrection = " << m_dGotoTimeCorrection << std::endl;
+    m_sLogFile.flush();
+#endif
+}
+
 int CRTIDome::isOpenComplete(bool &bComplete)
 {
     int nErr = PLUGIN_OK;
@@ -1408,6 +2855,19 @@ int CRTIDome::isParkComplete(bool &bComplete)
     m_sLogFile.flush();
 #endif
 
+    if(m_bParking && m_bWaypoints) {
+        nErr = checkWaypoints(bFoundHome);
+        if(nErr || !bFoundHome) {
+            getDomeAz(dDomeAz);
+            bComplete = false;
+            if(nErr)
+                m_bParking = false;
+            return nErr;
+        }
+        // the queue is done, check we're at park
+        m_bParking = false;
+    }
+
     if(isDomeMoving()) {
         getDomeAz(dDomeAz);
         bComplete = false;
@@ -1465,6 +2925,18 @@ int CRTIDome::isUnparkComplete(bool &bComplete)
         m_sLogFile.flush();
 #endif
     }
+    else if (m_bUnParking && m_bWaypoints) {
+        nErr = checkWaypoints(bComplete);
+        if(nErr) {
+            m_bUnParking = false;
+            return nErr;
+        }
+        if(bComplete) {
+            m_bParked = false;
+            m_bUnParking = false;
+            syncDome(m_dHomeAz, m_dCurrentElPosition);
+        }
+    }
     else if (m_bUnParking) {
 #if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
         m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isUnparkComplete] unparking.. checking if we're home" << std::endl;
@@ -1520,6 +2992,11 @@ int CRTIDome::isFindHomeComplete(bool &bComplete)
 #ifdef PLUGIN_DEBUG
         m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isFindHomeComplete] At Home" << std::endl;
         m_sLogFile.flush();
+        int nTimeMs, nEdgeError, nMinError, nMaxError, nCaptures;
+        if(getHomingDiagnostics(nTimeMs, nEdgeError, nMinError, nMaxError, nCaptures) == PLUGIN_OK) {
+            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isFindHomeComplete] homing took " << nTimeMs << " ms, edge error " << nEdgeError << " steps, spread " << (nMaxError - nMinError) << " steps over " << nCaptures << " captures" << std::endl;
+            m_sLogFile.flush();
+        }
 #endif
     }
     else {
@@ -1577,6 +3054,12 @@ int CRTIDome::isCalibratingComplete(bool &bComplete)
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isCalibratingComplete] m_bCalibrating = " << (m_bCalibrating?"True":"False") << std::endl;
     m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isCalibratingComplete] bComplete = " << (bComplete?"True":"False") << std::endl;
     m_sLogFile.flush();
+    int nMagnetWidth, nSpread, nTurnTimeMs;
+    bool bSinglePass;
+    if(getCalibrationDiagnostics(nMagnetWidth, nSpread, nTurnTimeMs, bSinglePass) == PLUGIN_OK) {
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isCalibratingComplete] " << (bSinglePass?"single pass":"two pass") << ", magnet width " << nMagnetWidth << " steps, edge spread " << nSpread << " steps, turn time " << nTurnTimeMs << " ms" << std::endl;
+        m_sLogFile.flush();
+    }
 #endif
     return nErr;
 }
@@ -1594,8 +3077,14 @@ int CRTIDome::abortCurrentCommand()
     m_bCalibrating = false;
     m_bParking = false;
     m_bUnParking = false;
+    m_bWaypoints = false;
     m_nGotoTries = 1;   // prevents the goto retry
     m_nHomingTries = 1; // prevents the find home retry
+    stopMoveModel();
+    m_bTimingGoto = false;
+    m_bGotoInProgress = false;
+    m_bPendingGoto = false;
+    m_bGotoSuppressed = false;
 
     nErr = domeCommand("a#", sResp, 'a');
 
@@ -1716,10 +3205,19 @@ int CRTIDome::setParkAz(double dAz)
 
 double CRTIDome::getCurrentAz()
 {
+    if(!m_bIsConnected)
+        return m_dCurrentAzPosition;
+
+    if(m_bMoveModelActive) {
+        // while the model says we're moving only ask the controller once in a while to correct it.
+        if(m_AzRefreshTimer.GetElapsedSeconds() < AZ_MODEL_REFRESH_INTERVAL &&
+           (m_dMoveTimeOffset + m_MoveTimer.GetElapsedSeconds()) < getMoveDuration(m_dMoveSteps)) {
+            m_dCurrentAzPosition = getMoveModelAz();
+            return m_dCurrentAzPosition;
+        }
+    }
 
-    if(m_bIsConnected) {
-        getDomeAz(m_dCurrentAzPosition);
-   }
+    getDomeAz(m_dCurrentAzPosition);
     return m_dCurrentAzPosition;
 }
 
@@ -1814,6 +3312,160 @@ int CRTIDome::getRainSensorStatus(int &nStatus)
     return nErr;
 }
 
+int CRTIDome::getHomingDiagnostics(int &nTimeMs, int &nEdgeError, int &nMinError, int &nMaxError, int &nCaptures)
+{
+    int nErr = PLUGIN_OK;
+    std::string sResp;
+    std::vector<std::string> svFields;
+
+    nTimeMs = 0;
+    nEdgeError = 0;
+    nMinError = 0;
+    nMaxError = 0;
+    nCaptures = 0;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_fVersion < HOMING_DIAG_MIN_VERSION)
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+
+    nErr = domeCommand("J#", sResp, 'J');
+    if(nErr) {
+        return nErr;
+    }
+
+    nErr = parseFields(sResp, svFields, ',');
+    if(nErr || svFields.size() < 5) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getHomingDiagnostics] bad response : " << sResp << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    try {
+        nTimeMs = std::stoi(svFields[0]);
+        nEdgeError = std::stoi(svFields[1]);
+        nMinError = std::stoi(svFields[2]);
+        nMaxError = std::stoi(svFields[3]);
+        nCaptures = std::stoi(svFields[4]);
+    }
+    catch(const std::exception& e) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getHomingDiagnostics] convertsion exception = " << e.what() << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getHomingDiagnostics] nTimeMs = " << nTimeMs << " nEdgeError = " << nEdgeError << " nMinError = " << nMinError << " nMaxError = " << nMaxError << " nCaptures = " << nCaptures << std::endl;
+    m_sLogFile.flush();
+#endif
+
+    return nErr;
+}
+
+int CRTIDome::getCalibrationDiagnostics(int &nMagnetWidth, int &nSpread, int &nTurnTimeMs, bool &bSinglePass)
+{
+    int nErr = PLUGIN_OK;
+    std::string sResp;
+    std::vector<std::string> svFields;
+
+    nMagnetWidth = 0;
+    nSpread = 0;
+    nTurnTimeMs = 0;
+    bSinglePass = false;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_fVersion < CALIBRATION_DIAG_MIN_VERSION)
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+
+    nErr = domeCommand("J#", sResp, 'J');
+    if(nErr) {
+        return nErr;
+    }
+
+    // the calibration fields follow the 6 homing ones
+    nErr = parseFields(sResp, svFields, ',');
+    if(nErr || svFields.size() < 10) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getCalibrationDiagnostics] bad response : " << sResp << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    try {
+        nMagnetWidth = std::stoi(svFields[6]);
+        nSpread = std::stoi(svFields[7]);
+        nTurnTimeMs = std::stoi(svFields[8]);
+        bSinglePass = std::stoi(svFields[9]) == 1;
+    }
+    catch(const std::exception& e) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getCalibrationDiagnostics] convertsion exception = " << e.what() << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    return nErr;
+}
+
+int CRTIDome::getSlipStats(int &nCrossings, int &nLastSlip, int &nMaxSlip, int &nTotalCorrection, int &nRejected)
+{
+    int nErr = PLUGIN_OK;
+    std::string sResp;
+    std::vector<std::string> svFields;
+
+    nCrossings = 0;
+    nLastSlip = 0;
+    nMaxSlip = 0;
+    nTotalCorrection = 0;
+    nRejected = 0;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_fVersion < SLIP_STATS_MIN_VERSION)
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+
+    nErr = domeCommand("S#", sResp, 'S');
+    if(nErr) {
+        return nErr;
+    }
+
+    nErr = parseFields(sResp, svFields, ',');
+    if(nErr || svFields.size() < 5) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getSlipStats] bad response : " << sResp << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    try {
+        nCrossings = std::stoi(svFields[0]);
+        nLastSlip = std::stoi(svFields[1]);
+        nMaxSlip = std::stoi(svFields[2]);
+        nTotalCorrection = std::stoi(svFields[3]);
+        nRejected = std::stoi(svFields[4]);
+    }
+    catch(const std::exception& e) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getSlipStats] convertsion exception = " << e.what() << std::endl;
+        m_sLogFile.flush();
+#endif
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    return nErr;
+}
+
 int CRTIDome::getRotationSpeed(int &nSpeed)
 {
     int nErr = PLUGIN_OK;
@@ -1857,6 +3509,8 @@ int CRTIDome::setRotationSpeed(int nSpeed)
 
     ssTmp << "r" << nSpeed << "#";
     nErr = domeCommand(ssTmp.str(), sResp, 'r');
+    if(!nErr)
+        m_nRotationSpeed = nSpeed;
     return nErr;
 }
 
@@ -1903,6 +3557,8 @@ int CRTIDome::setRotationAcceleration(int nAcceleration)
 
     ssTmp << "e" << nAcceleration << "#";
     nErr = domeCommand(ssTmp.str(), sResp, 'e');
+    if(!nErr)
+        m_nRotationAcceleration = nAcceleration;
 
     return nErr;
 }
@@ -2126,6 +3782,82 @@ int CRTIDome::setRainAction(const int &nAction)
 
 }
 
+int CRTIDome::setConfiguration(int nStepsPerRev, int nAcceleration, int nSpeed, bool bNormal, double dHomeAz, double dParkAz, double dDomeCutOff, int nRainAction,
+                               int nShutterSpeed, int nShutterAcceleration, int nShutterWatchdog, double dShutterCutOff)
+{
+    int nErr = PLUGIN_OK;
+    std::stringstream ssTmp;
+    std::string sResp;
+    bool bShutterFields;
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
+
+    if(m_fVersion < BULK_CONFIG_MIN_VERSION) {
+        nErr |= setDefaultDir(bNormal);
+        nErr |= setHomeAz(dHomeAz);
+        nErr |= setParkAz(dParkAz);
+        nErr |= setNbTicksPerRev(nStepsPerRev);
+        nErr |= setRotationSpeed(nSpeed);
+        nErr |= setRotationAcceleration(nAcceleration);
+        nErr |= setBatteryCutOff(dDomeCutOff, dShutterCutOff);
+        nErr |= setRainAction(nRainAction);
+        if(m_bShutterPresent) {
+            nErr |= setShutterSpeed(nShutterSpeed);
+            nErr |= setShutterAcceleration(nShutterAcceleration);
+            nErr |= setSutterWatchdogTimerValue(nShutterWatchdog);
+        }
+        return nErr;
+    }
+
+    // an older shutter firmware doesn't know N, it gets its settings one by one after the rotator ones.
+    bShutterFields = m_bShutterPresent && m_fShutterVersion >= SHUTTER_BULK_CONFIG_MIN_VERSION;
+
+    ssTmp << "N" << nStepsPerRev << "," << nAcceleration << "," << nSpeed << "," << (bNormal?"0":"1") << ","
+          << std::fixed << std::setprecision(2) << dHomeAz << "," << dParkAz << ","
+          << int(dDomeCutOff * 100.0) << "," << nRainAction;
+    if(bShutterFields)
+        ssTmp << "," << nShutterSpeed << "," << nShutterAcceleration << "," << (nShutterWatchdog * 1000) << "," << int(dShutterCutOff * 100.0);
+    ssTmp << "#";
+
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setConfiguration] sending " << ssTmp.str() << std::endl;
+    m_sLogFile.flush();
+#endif
+
+    nErr = domeCommand(ssTmp.str(), sResp, 'N');
+    if(nErr)
+        return nErr;
+
+    // nothing was applied if the values were refused or the shutter didn't get its part
+    if(sResp.size() && (sResp.at(0) == 'E' || sResp.at(0) == 'U')) {
+#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
+        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setConfiguration] configuration refused : " << sResp << std::endl;
+        m_sLogFile.flush();
+#endif
+        if(sResp.at(0) == 'U')
+            return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_SHUTTER_UNAVAILABLE);
+        return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, ERR_CMDFAILED);
+    }
+
+    m_nNbStepPerRev = nStepsPerRev;
+    stopMoveModel();
+    m_nRotationSpeed = nSpeed;
+    m_nRotationAcceleration = nAcceleration;
+    m_dHomeAz = dHomeAz;
+    m_dParkAz = dParkAz;
+
+    if(m_bShutterPresent && !bShutterFields) {
+        nErr |= setShutterSpeed(nShutterSpeed);
+        nErr |= setShutterAcceleration(nShutterAcceleration);
+        nErr |= setSutterWatchdogTimerValue(nShutterWatchdog);
+        std::stringstream().swap(ssTmp);
+        ssTmp << "K" << int(dShutterCutOff * 100.0) << "#";
+        nErr |= domeCommand(ssTmp.str(), sResp, 'K');
+    }
+    return nErr;
+}
+
 int CRTIDome::getPanId(int &nPanId)
 {
     int nErr = PLUGIN_OK;
@@ -28,6 +28,9 @@
 #include <fstream>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
 #include <ctime>
 
 // SB includes
@@ -36,6 +39,7 @@
 #include "../../licensedinterfaces/serxinterface.h"
 
 #include "StopWatch.h"
+#include "DomeGeometry.h"
 
 #define MAKE_ERR_CODE(P_ID, DTYPE, ERR_CODE)  (((P_ID<<24) & 0xff000000) | ((DTYPE<<16) & 0x00ff0000)  | (ERR_CODE & 0x0000ffff))
 
@@ -46,6 +50,36 @@
 #define ND_LOG_BUFFER_SIZE 256
 #define PANID_TIMEOUT 15    // in seconds
 #define RAIN_CHECK_INTERVAL 10
+#define LINK_DOWN_TIMEOUTS 3             // timeouts in a row before we consider the network link down
+#define LINK_RETRY_MIN_DELAY 500        // ms
+#define LINK_RETRY_MAX_DELAY 30000      // ms
+#define SHUTTER_DOWN_TIMEOUTS 2          // shutter commands timing out in a row before we stop sending them
+#define SHUTTER_PROBE_INTERVAL 5.0      // in seconds, how often we try the shutter when its link is down
+#define TAGGED_FRAMES_MIN_VERSION 2.647f // first firmware that echoes the ~xx sequence id
+#define MAX_STALE_READS 4               // reads of late replies before we give up on ours
+#define BINARY_FRAMES_MIN_VERSION 2.648f // first firmware with binary frames
+#define HOMING_DIAG_MIN_VERSION 2.649f  // first firmware with two speed homing and its J diagnostics
+#define CALIBRATION_DIAG_MIN_VERSION 2.650f // first firmware with the single pass calibration fields in the J reply
+#define SLIP_STATS_MIN_VERSION 2.651f   // first firmware with drift correction and its S statistics
+#define WAYPOINTS_MIN_VERSION 2.653f    // first firmware with the W waypoint queue
+#define BULK_CONFIG_MIN_VERSION 2.654f  // first firmware with the N bulk configuration command
+#define SHUTTER_BULK_CONFIG_MIN_VERSION 2.648f  // first shutter firmware that takes its part of the N command
+#define CONFIG_BLOB_MIN_VERSION 2.655f  // first firmware with the X configuration blob
+#define SHUTTER_CONFIG_BLOB_MIN_VERSION 2.649f  // first shutter firmware with the Z configuration blob
+#define FINGERPRINT_STATE_MIN_VERSION 2.661f // first firmware with azimuth and home status in the A reply, A1 and the hello on A
+#define BIN_FRAME_START     0xA5
+#define BIN_MAX_PAYLOAD     251         // so length, sequence, payload and CRC fit in 255 bytes
+#define BIN_STATUS_CMD      0x01        // binary only, azimuth, direction, home status, shutter state, flags and volts
+#define BIN_STATUS_SIZE     9
+#define BIN_CRC_ERROR       0x15        // the controller got a corrupted frame
+#define BIN_REPLY_TOO_LONG  0x16        // the controller reply doesn't fit in a frame
+#define AZ_MODEL_REFRESH_INTERVAL 1.0   // in seconds, how often we correct the move model with the real position
+// Must match STEP_TYPE in Hardware/Firmwares/RotatorEth/RotatorClass.h, the rotator truncates every move to a
+// multiple of it. It's not reported by the controller, if it's smaller here gotos that stop short fail after one retry.
+#define DOME_STEP_TYPE 8
+#define GOTO_ETA_FILTER 0.25            // weight of the last goto in the ETA correction
+#define GOTO_ETA_MIN_CORRECTION 0.5
+#define GOTO_ETA_MAX_CORRECTION 3.0
 
 #define PLUGIN_VERSION      1.26
 #define PLUGIN_ID   1
@@ -53,7 +87,7 @@
 // #define PLUGIN_DEBUG 2
 
 // Error code
-enum RTIDomeErrors {PLUGIN_OK=0, NOT_CONNECTED, CANT_CONNECT, BAD_CMD_RESPONSE, COMMAND_FAILED, COMMAND_TIMEOUT, ERR_RAINING, ERR_BATTERY_LOW};
+enum RTIDomeErrors {PLUGIN_OK=0, NOT_CONNECTED, CANT_CONNECT, BAD_CMD_RESPONSE, COMMAND_FAILED, COMMAND_TIMEOUT, ERR_RAINING, ERR_BATTERY_LOW, ERR_SHUTTER_UNAVAILABLE};
 enum RTIDomeShutterState { OPEN=0 , CLOSED, OPENING, CLOSING, BOTTOM_OPEN, BOTTOM_CLOSED, BOTTOM_OPENING, BOTTOM_CLOSING, SHUTTER_ERROR, FINISHING_OPEN, FINISHING_CLOSE };
 
 enum HomeStatuses {NOT_AT_HOME = 0, HOMED, ATHOME};
@@ -61,6 +95,7 @@ enum RainActions {DO_NOTHING=0, HOME, PARK};
 enum MoveDirection {MOVE_NEGATIVE = -1, MOVE_NONE, MOVE_POSITIVE};
 // RG-11
 enum RainSensorStates {RAINING= 0, NOT_RAINING, RAIN_UNKNOWN};
+enum WaypointStatuses {WAYPOINTS_IDLE = 0, WAYPOINTS_RUNNING, WAYPOINTS_CANCELLED};
 
 class CRTIDome
 {
@@ -71,6 +106,16 @@ public:
     int         Connect(const char *pszPort);
     void        Disconnect(void);
     const bool  IsConnected(void) { return m_bIsConnected; }
+    bool        IsLinkDown(void) { return m_bLinkDown; }
+    bool        isShutterLinkDown() { return m_bShutterLinkDown; }
+    // each command carries a sequence id so late replies can be dropped without purging the port
+    void        setTaggedFrames(bool bEnabled) { m_bTaggedFrames = bEnabled; }
+    unsigned long getStaleReplies() { return m_nStaleReplies; }
+    // length prefixed frames with a CRC16, negotiated on connect with firmware that supports them
+    void        setBinaryFrames(bool bEnabled) { m_bBinaryFrames = bEnabled; }
+    bool        isBinaryMode() { return m_bBinaryMode; }
+    unsigned long getCrcErrors() { return m_nCrcErrors; }
+    unsigned long getReconnects() { return m_nReconnects; }
 
     void        setSerxPointer(SerXInterface *p) { m_pSerx = p; }
 
@@ -79,6 +124,7 @@ public:
     int parkDome(void);
     int unparkDome(void);
     int gotoAzimuth(double dNewAz);
+    int slewToAzimuth(double dNewAz, double dNewEl);
     int openShutter();
     int closeShutter();
     int getFirmwareVersion(std::string &sVersion, float &fVersion);
@@ -99,6 +145,7 @@ public:
     int abortCurrentCommand();
     int sendShutterHello();
     int getShutterPresent(bool &bShutterPresent);
+    bool isShutterPresent() { return m_bShutterPresent; }
     // getter/setter
     int getNbTicksPerRev();
     int setNbTicksPerRev(int nSteps);
@@ -114,6 +161,18 @@ public:
     double getCurrentAz();
     double getCurrentEl();
 
+    // goto time estimates, in seconds
+    int getGotoETA(double dAz, double &dSeconds);
+    int getGotoTimeLeft(double &dSeconds);
+    double getGotoTimeCorrection() { return m_dGotoTimeCorrection; }
+    void setGotoTimeCorrection(double dCorrection);
+
+    // goto suppression when slaving, a 0 slit width disables it
+    void setSlitWidth(double dWidth, double dHysteresis);
+    unsigned long getAvoidedGotos() { return m_nAvoidedGotos; }
+    // mount and dome geometry used when slaving, a 0 dome radius disables it
+    void setDomeGeometry(double dLatitude, double dDomeRadius, double dMountEast, double dMountNorth, double dMountUp, double dGemArm, double dFlipHA);
+
     int getBatteryLevels(double &domeVolts, double &dDomeCutOff, double &dShutterVolts, double &dShutterCutOff);
     int setBatteryCutOff(double dDomeCutOff, double dShutterCutOff);
 
@@ -122,6 +181,13 @@ public:
 
     int getRainSensorStatus(int &nStatus);
 
+    // last homing time, home edge error relative to where we expected it and its min/max over nCaptures homings
+    int getHomingDiagnostics(int &nTimeMs, int &nEdgeError, int &nMinError, int &nMaxError, int &nCaptures);
+    // last calibration magnet width and rising/falling edge turn spread in steps, single pass or two pass fall back
+    int getCalibrationDiagnostics(int &nMagnetWidth, int &nSpread, int &nTurnTimeMs, bool &bSinglePass);
+    // home crossings seen during normal moves and the slip corrected on them, in steps. Use it to decide when to re-home
+    int getSlipStats(int &nCrossings, int &nLastSlip, int &nMaxSlip, int &nTotalCorrection, int &nRejected);
+
     int getRotationSpeed(int &nSpeed);
     int setRotationSpeed(int nSpeed);
 
@@ -143,6 +209,11 @@ public:
     int getRainAction(int &nAction);
     int setRainAction(const int &nAction);
 
+    // all the settings of the dialog in one command, validated and saved once by the controller.
+    // Older firmwares get one command per setting.
+    int setConfiguration(int nStepsPerRev, int nAcceleration, int nSpeed, bool bNormal, double dHomeAz, double dParkAz, double dDomeCutOff, int nRainAction,
+                         int nShutterSpeed, int nShutterAcceleration, int nShutterWatchdog, double dShutterCutOff);
+
     int getPanId(int &nPanId);
     int setPanId(const int nPanId);
     int getShutterPanId(int &nPanId);
@@ -150,6 +221,11 @@ public:
     
     int restoreDomeMotorSettings();
     int restoreShutterMotorSettings();
+
+    // all the rotator and shutter settings saved to / restored from a file, one command per controller
+    int backupConfig();
+    int restoreConfig();
+    void getConfigBackupFileName(std::string &fName);
     
     void enableRainStatusFile(bool bEnable);
     void getRainStatusFileName(std::string &fName);
@@ -176,6 +252,37 @@ protected:
 
     int             domeCommand(const std::string sCmd, std::string &sResp, char respCmdCode, int nTimeout = MAX_TIMEOUT);
     int             readResponse(std::string &sResp, int nTimeout = MAX_TIMEOUT);
+    int             readTaggedResponse(const std::string &sTag, std::string &sResp, int nTimeout = MAX_TIMEOUT);
+    std::string     buildFrame(const std::string &sPayload, uint8_t nSequence);
+    int             readBytes(uint8_t *pBuf, int nBytes, int nTimeout);
+    int             readFrame(uint8_t nSequence, std::string &sPayload, int nTimeout = MAX_TIMEOUT);
+    int             negotiateBinaryFrames();
+    int             getBinaryStatus(double &dDomeAz, int &nDirection, int &nHomeStatus);
+    int             domeCommands(const std::vector<std::string> &svCmds, std::vector<std::string> &svResps, int nTimeout = MAX_TIMEOUT);
+
+    // connection profile cache
+    int             getFingerprint(std::string &sFingerprint, bool &bShutterPresent, int &nShutterState, double &dDomeAz, bool bBinaryFrames);
+    float           getCachedFirmwareVersion();
+    bool            loadProfile(const std::string &sFingerprint);
+    void            saveProfile(const std::string &sFingerprint);
+    int             parseFirmwareVersion(const std::string sResp, std::string &sVersion, float &fVersion);
+    int             readControllerState();
+
+    bool            isShutterCommand(const std::string &sCmd);
+    bool            checkShutterLink(const std::string &sCmd);
+    void            updateShutterLink(const std::string &sCmd, int nErr, const std::string &sResp);
+
+    // network link supervision
+    void            checkLink(int nErr);
+    int             resumeLink();
+    void            linkSupervisor();
+    void            startLinkSupervisor();
+    void            stopLinkSupervisor();
+
+    // park and unpark via home as one firmware transaction
+    int             startWaypoints(const std::string &sSegments);
+    int             getWaypointStatus(int &nStatus);
+    int             checkWaypoints(bool &bComplete);
 
     int             getDomeAz(double &dDomeAz);
     int             getDomeEl(double &dDomeEl);
@@ -190,6 +297,18 @@ protected:
     int             parseFields(std::string sResp, std::vector<std::string> &svFields, char cSeparator);
 
     bool            checkBoundaries(double dGotoAz, double dDomeAz);
+    double          getAngularDistance(double dFromAz, double dToAz);
+
+    // move model, used to report the dome position during a goto without talking to the controller
+    void            startMoveModel(double dGotoAz);
+    void            stopMoveModel();
+    void            updateMoveModel(double dDomeAz);
+    double          getMoveModelAz();
+    void            getMoveProfile(double dSteps, double &dAccelTime, double &dCruiseTime, double &dPeakSpeed);
+    double          getMoveStepsAt(double dSteps, double dTime);
+    double          getMoveTimeAt(double dSteps, double dStepsDone);
+    double          getMoveDuration(double dSteps);
+    void            updateGotoTimeCorrection();
     
     SerXInterface   *m_pSerx;
 
@@ -212,6 +331,29 @@ protected:
 
     double          m_dGotoAz;
 
+    int             m_nRotationSpeed;           // steps/s
+    int             m_nRotationAcceleration;    // steps/s^2
+    bool            m_bMoveModelActive;
+    double          m_dMoveTargetAz;
+    double          m_dMoveSteps;               // length of the current move
+    int             m_nMoveDirection;
+    double          m_dMoveTimeOffset;          // where we are in the move profile when m_MoveTimer was reset
+    CStopWatch      m_MoveTimer;
+    CStopWatch      m_AzRefreshTimer;
+
+    double          m_dGotoTimeCorrection;      // observed / predicted goto duration
+    bool            m_bTimingGoto;
+    double          m_dGotoPredictedTime;
+    CStopWatch      m_GotoTimer;
+
+    double          m_dSlitWidth;
+    double          m_dSlitHysteresis;
+    bool            m_bGotoInProgress;
+    bool            m_bGotoSuppressed;
+    bool            m_bPendingGoto;
+    double          m_dPendingGotoAz;
+    unsigned long   m_nAvoidedGotos;
+    CDomeGeometry   m_DomeGeometry;
 
     std::string     m_sFirmwareVersion;
     float           m_fVersion;
@@ -224,6 +366,7 @@ protected:
     int             m_nGotoTries;
     bool            m_bParking;
     bool            m_bUnParking;
+    bool            m_bWaypoints;   // the park or unpark is running as a firmware waypoint queue
     int             m_nIsRaining;
     bool            m_bHomeOnPark;
     bool            m_bHomeOnUnpark;
@@ -234,6 +377,28 @@ protected:
     bool            m_bSaveRainStatus;
     int             m_nRainStatus;
     CStopWatch      m_cRainCheckTimer;
+
+    std::string     m_sProfilefilePath;
+    std::string     m_sConfigBackupfilePath;
+
+    std::recursive_mutex    m_DevMutex;
+    std::atomic<bool>       m_bLinkDown;
+    std::atomic<bool>       m_bPortReopened;    // the supervisor reopened the port, the state refresh is left to the next command
+    std::atomic<bool>       m_bSupervisorRunning;
+    std::thread             m_LinkSupervisorThread;
+    int                     m_nConsecutiveTimeouts;
+    unsigned long           m_nReconnects;
+
+    bool                    m_bTaggedFrames;
+    unsigned int            m_nSequence;
+    unsigned long           m_nStaleReplies;
+    bool                    m_bBinaryFrames;
+    bool                    m_bBinaryMode;
+    unsigned long           m_nCrcErrors;
+
+    bool                    m_bShutterLinkDown;
+    int                     m_nShutterTimeouts;
+    CStopWatch              m_ShutterProbeTimer;
     
     std::string     m_IpAddress;
     std::string     m_SubnetMask;
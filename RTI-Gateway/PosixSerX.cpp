@@ -0,0 +1,246 @@
+//
+//  PosixSerX.cpp
+//  RTI-Gateway
+//
+//  SerXInterface implementation for Linux so CRTIDome can be used outside of TheSkyX.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <termios.h>
+#include <netdb.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "PosixSerX.h"
+
+CPosixSerX::CPosixSerX()
+{
+    m_nFd = -1;
+    m_bIsSocket = false;
+}
+
+CPosixSerX::~CPosixSerX()
+{
+    close();
+}
+
+int CPosixSerX::open(const char* pszPort, const unsigned long& dwBaudRate, const Parity& /* parity */, const char* /* pszSession */)
+{
+    std::string sPort(pszPort);
+    size_t nPos;
+
+    close();
+
+    // TCP:host:port
+    if(sPort.find("TCP:") == 0) {
+        sPort = sPort.substr(4);
+        nPos = sPort.rfind(':');
+        if(nPos == std::string::npos)
+            return ERR_COMMOPENING;
+        return openSocket(sPort.substr(0, nPos), sPort.substr(nPos+1));
+    }
+    return openSerial(sPort, dwBaudRate);
+}
+
+int CPosixSerX::openSerial(const std::string &sDevice, unsigned long nBaudRate)
+{
+    struct termios tty;
+    speed_t nSpeed;
+
+    switch(nBaudRate) {
+        case 9600:
+            nSpeed = B9600;
+            break;
+        case 19200:
+            nSpeed = B19200;
+            break;
+        case 38400:
+            nSpeed = B38400;
+            break;
+        case 57600:
+            nSpeed = B57600;
+            break;
+        default:
+            nSpeed = B115200;
+            break;
+    }
+
+    m_nFd = ::open(sDevice.c_str(), O_RDWR | O_NOCTTY);
+    if(m_nFd < 0)
+        return ERR_COMMOPENING;
+
+    memset(&tty, 0, sizeof(tty));
+    if(tcgetattr(m_nFd, &tty) != 0) {
+        close();
+        return ERR_COMMOPENING;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, nSpeed);
+    cfsetospeed(&tty, nSpeed);
+    tty.c_cflag |= (CLOCAL | CREAD);
+    tty.c_cflag &= ~(PARENB | CSTOPB | CRTSCTS);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    if(tcsetattr(m_nFd, TCSANOW, &tty) != 0) {
+        close();
+        return ERR_COMMOPENING;
+    }
+    m_bIsSocket = false;
+    tcflush(m_nFd, TCIOFLUSH);
+    return SB_OK;
+}
+
+int CPosixSerX::openSocket(const std::string &sHost, const std::string &sPort)
+{
+    struct addrinfo hints;
+    struct addrinfo *pResult = NULL;
+    struct addrinfo *pAddr;
+    int nFlag = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(sHost.c_str(), sPort.c_str(), &hints, &pResult) != 0)
+        return ERR_COMMOPENING;
+
+    for(pAddr = pResult; pAddr; pAddr = pAddr->ai_next) {
+        m_nFd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+        if(m_nFd < 0)
+            continue;
+        if(connect(m_nFd, pAddr->ai_addr, pAddr->ai_addrlen) == 0)
+            break;
+        ::close(m_nFd);
+        m_nFd = -1;
+    }
+    freeaddrinfo(pResult);
+    if(m_nFd < 0)
+        return ERR_COMMOPENING;
+
+    // commands are small, don't wait to fill a packet
+    setsockopt(m_nFd, IPPROTO_TCP, TCP_NODELAY, &nFlag, sizeof(nFlag));
+    m_bIsSocket = true;
+    return SB_OK;
+}
+
+int CPosixSerX::close()
+{
+    if(m_nFd >= 0)
+        ::close(m_nFd);
+    m_nFd = -1;
+    return SB_OK;
+}
+
+int CPosixSerX::flushTx(void)
+{
+    if(m_nFd < 0)
+        return ERR_COMMNOLINK;
+    if(!m_bIsSocket)
+        tcdrain(m_nFd);
+    return SB_OK;
+}
+
+int CPosixSerX::purgeTxRx(void)
+{
+    char buffer[256];
+    int nBytesWaiting = 0;
+
+    if(m_nFd < 0)
+        return ERR_COMMNOLINK;
+
+    if(!m_bIsSocket) {
+        tcflush(m_nFd, TCIOFLUSH);
+        return SB_OK;
+    }
+    // nothing to flush on a socket, just drop what we already received
+    while(bytesWaitingRx(nBytesWaiting) == SB_OK && nBytesWaiting > 0) {
+        if(::read(m_nFd, buffer, nBytesWaiting > (int)sizeof(buffer) ? sizeof(buffer) : nBytesWaiting) <= 0)
+            break;
+    }
+    return SB_OK;
+}
+
+int CPosixSerX::waitForBytesRx(const int& nNumber, const int& nTimeOutMilli)
+{
+    struct pollfd pfd;
+    int nBytesWaiting = 0;
+    int nElapsed = 0;
+
+    if(m_nFd < 0)
+        return ERR_COMMNOLINK;
+
+    pfd.fd = m_nFd;
+    pfd.events = POLLIN;
+    while(nElapsed < nTimeOutMilli) {
+        bytesWaitingRx(nBytesWaiting);
+        if(nBytesWaiting >= nNumber)
+            return SB_OK;
+        if(poll(&pfd, 1, 10) < 0 && errno != EINTR)
+            return ERR_COMMNOLINK;
+        nElapsed += 10;
+    }
+    return ERR_RXTIMEOUT;
+}
+
+int CPosixSerX::readFile(void* lpBuf, const unsigned long dwLength, unsigned long& dwReadLength, const unsigned long& dwTimeOut)
+{
+    struct pollfd pfd;
+    ssize_t nRead;
+    int nErr;
+
+    dwReadLength = 0;
+    if(m_nFd < 0)
+        return ERR_COMMNOLINK;
+
+    pfd.fd = m_nFd;
+    pfd.events = POLLIN;
+    while(dwReadLength < dwLength) {
+        nErr = poll(&pfd, 1, (int)dwTimeOut);
+        if(nErr < 0 && errno == EINTR)
+            continue;
+        if(nErr <= 0)
+            break; // timeout, the caller checks dwReadLength
+        nRead = ::read(m_nFd, (char *)lpBuf + dwReadLength, dwLength - dwReadLength);
+        if(nRead <= 0) {
+            if(m_bIsSocket) // connection closed by the other side
+                close();
+            return ERR_COMMNOLINK;
+        }
+        dwReadLength += nRead;
+    }
+    return SB_OK;
+}
+
+int CPosixSerX::writeFile(void* lpBuf, const unsigned long& dwLength, unsigned long& dwBytesWrite)
+{
+    ssize_t nWritten;
+
+    dwBytesWrite = 0;
+    if(m_nFd < 0)
+        return ERR_COMMNOLINK;
+
+    while(dwBytesWrite < dwLength) {
+        nWritten = ::write(m_nFd, (char *)lpBuf + dwBytesWrite, dwLength - dwBytesWrite);
+        if(nWritten < 0 && errno == EINTR)
+            continue;
+        if(nWritten <= 0)
+            return ERR_TXTIMEOUT;
+        dwBytesWrite += nWritten;
+    }
+    return SB_OK;
+}
+
+int CPosixSerX::bytesWaitingRx(int &nBytesWaiting)
+{
+    nBytesWaiting = 0;
+    if(m_nFd < 0)
+        return ERR_COMMNOLINK;
+    if(ioctl(m_nFd, FIONREAD, &nBytesWaiting) < 0)
+        return ERR_COMMNOLINK;
+    return SB_OK;
+}
@@ -0,0 +1,43 @@
+//
+//  PosixSerX.h
+//  RTI-Gateway
+//
+//  SerXInterface implementation for Linux so CRTIDome can be used outside of TheSkyX.
+//  The port is either a serial device (/dev/ttyACM0) or a network address (TCP:192.168.0.99:2323)
+//
+
+#ifndef __PosixSerX__
+#define __PosixSerX__
+
+#include <string>
+
+#include "../../../licensedinterfaces/sberrorx.h"
+#include "../../../licensedinterfaces/serxinterface.h"
+
+class CPosixSerX : public SerXInterface
+{
+public:
+    CPosixSerX();
+    virtual ~CPosixSerX();
+
+    virtual int open(const char* pszPort, const unsigned long& dwBaudRate = 9600, const Parity& parity = B_NOPARITY, const char* pszSession = 0);
+    virtual int close();
+    virtual bool isConnected(void) const { return m_nFd >= 0; }
+
+    virtual int flushTx(void);
+    virtual int purgeTxRx(void);
+
+    virtual int waitForBytesRx(const int& nNumber, const int& nTimeOutMilli);
+    virtual int readFile(void* lpBuf, const unsigned long dwLength, unsigned long& dwReadLength, const unsigned long& dwTimeOut = 1000);
+    virtual int writeFile(void* lpBuf, const unsigned long& dwLength, unsigned long& dwBytesWrite);
+    virtual int bytesWaitingRx(int &nBytesWaiting);
+
+private:
+    int         m_nFd;
+    bool        m_bIsSocket;
+
+    int         openSerial(const std::string &sDevice, unsigned long nBaudRate);
+    int         openSocket(const std::string &sHost, const std::string &sPort);
+};
+
+#endif
@@ -0,0 +1,260 @@
+//
+//  RTIGateway.cpp
+//  RTI-Gateway
+//
+//  Owns the connection to the RTI-Zone controller and shares it between many local clients.
+//
+
+#include "RTIGateway.h"
+
+// status commands refreshed by the poller
+static const char pollCommands[] = {'g', 'm', 'z', 'M', 'k', 'K', 'o', 'F'};
+// read only commands (when sent without a value) we can answer from the cache
+static const std::string cacheableCommands = "gmzMkKoFvVlitreynqQfjpuwERTYIU";
+// read only commands (when sent without a value) we always send to the controller, they don't change what's in the cache
+static const std::string uncachedQueries = "AJSWNXZPL";
+
+#define GATEWAY_RECONNECT_INTERVAL  5   // seconds
+
+CRTIGateway::CRTIGateway()
+{
+    m_nPollInterval = GATEWAY_POLL_INTERVAL;
+    m_bRunning = false;
+    m_nPollIndex = 0;
+    m_nCacheHits = 0;
+    m_nDeviceCommands = 0;
+    m_nCoalescedCommands = 0;
+}
+
+CRTIGateway::~CRTIGateway()
+{
+    stop();
+}
+
+int CRTIGateway::start(const std::string &sPort, int nPollInterval)
+{
+    int nErr;
+
+    m_nPollInterval = nPollInterval;
+    setSerxPointer(&m_SerX);
+    // transact() talks plain ASCII, don't let Connect switch the controller to binary frames
+    setBinaryFrames(false);
+    // use the normal connection sequence so the controller is in the same state as with the plugin
+    nErr = Connect(sPort.c_str());
+    if(nErr)
+        return nErr;
+
+    m_bRunning = true;
+    m_PollTimer.Reset();
+    m_IoThread = std::thread(&CRTIGateway::ioThread, this);
+    return PLUGIN_OK;
+}
+
+void CRTIGateway::stop()
+{
+    if(!m_bRunning)
+        return;
+
+    m_bRunning = false;
+    m_QueueCond.notify_all();
+    if(m_IoThread.joinable())
+        m_IoThread.join();
+
+    // don't call Disconnect as it aborts any movement in progress.
+    m_SerX.close();
+    m_bIsConnected = false;
+
+    // wake up anybody still waiting
+    std::lock_guard<std::mutex> lock(m_QueueMutex);
+    for(auto &req : m_Queue) {
+        req->nErr = ERR_COMMNOLINK;
+        req->bDone = true;
+    }
+    m_Queue.clear();
+    m_DoneCond.notify_all();
+}
+
+bool CRTIGateway::isCacheable(const std::string &sCmd)
+{
+    return sCmd.size() == 1 && cacheableCommands.find(sCmd[0]) != std::string::npos;
+}
+
+// anything with a value is a set or a move, single letter commands can be a move (h, a, O, ...) too
+bool CRTIGateway::changesState(const std::string &sCmd)
+{
+    if(sCmd.size() != 1)
+        return true;
+    return cacheableCommands.find(sCmd[0]) == std::string::npos && uncachedQueries.find(sCmd[0]) == std::string::npos;
+}
+
+// goto with a target, only the last one matters
+bool CRTIGateway::isCoalescable(const std::string &sCmd)
+{
+    return sCmd.size() > 1 && sCmd[0] == 'g';
+}
+
+int CRTIGateway::query(const std::string &sCmd, std::string &sResp)
+{
+    std::shared_ptr<Request> req;
+    std::map<char, CacheEntry>::iterator it;
+
+    if(sCmd.empty())
+        return BAD_CMD_RESPONSE;
+
+    if(isCacheable(sCmd)) {
+        std::lock_guard<std::mutex> lock(m_CacheMutex);
+        it = m_Cache.find(sCmd[0]);
+        if(it != m_Cache.end() && (it->second.timer.GetElapsedSeconds() * 1000) < GATEWAY_CACHE_MAX_AGE) {
+            sResp = it->second.sResp;
+            m_nCacheHits++;
+            return PLUGIN_OK;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(m_QueueMutex);
+    if(!m_bRunning)
+        return ERR_COMMNOLINK;
+
+    // share a pending request if we can
+    for(auto rit = m_Queue.rbegin(); rit != m_Queue.rend(); ++rit) {
+        if((*rit)->bStarted)
+            break;
+        if((*rit)->sCmd == sCmd) {
+            req = *rit;
+            break;
+        }
+        if(isCoalescable(sCmd) && isCoalescable((*rit)->sCmd)) {
+            // newer goto target replaces the one not yet sent
+            (*rit)->sCmd = sCmd;
+            req = *rit;
+            break;
+        }
+        if(!isCacheable((*rit)->sCmd))
+            break; // don't move a write across another write
+    }
+
+    if(req) {
+        m_nCoalescedCommands++;
+    }
+    else {
+        req = std::make_shared<Request>();
+        req->sCmd = sCmd;
+        req->nErr = PLUGIN_OK;
+        req->bDone = false;
+        req->bStarted = false;
+        m_Queue.push_back(req);
+        m_QueueCond.notify_one();
+    }
+
+    m_DoneCond.wait(lock, [&req]{ return req->bDone; });
+    sResp = req->sResp;
+    return req->nErr;
+}
+
+int CRTIGateway::transact(const std::string &sCmd, std::string &sResp)
+{
+    int nErr;
+    unsigned long ulBytesWrite;
+    std::string sFullCmd;
+
+    if(!m_SerX.isConnected())
+        return ERR_COMMNOLINK;
+
+    sFullCmd = sCmd + "#";
+    m_pSerx->purgeTxRx();
+    nErr = m_pSerx->writeFile((void *)(sFullCmd.c_str()), sFullCmd.size(), ulBytesWrite);
+    m_pSerx->flushTx();
+    if(nErr)
+        return nErr;
+
+    m_nDeviceCommands++;
+    nErr = readResponse(sResp, GATEWAY_CMD_TIMEOUT);
+    if(!nErr && sResp.empty())
+        nErr = BAD_CMD_RESPONSE;
+    return nErr;
+}
+
+void CRTIGateway::pollNext()
+{
+    int nErr;
+    std::string sCmd;
+    std::string sResp;
+
+    sCmd.assign(1, pollCommands[m_nPollIndex]);
+    m_nPollIndex = (m_nPollIndex + 1) % sizeof(pollCommands);
+
+    nErr = transact(sCmd, sResp);
+    if(nErr || sResp[0] != sCmd[0])
+        return;
+
+    std::lock_guard<std::mutex> lock(m_CacheMutex);
+    m_Cache[sCmd[0]].sResp = sResp;
+    m_Cache[sCmd[0]].timer.Reset();
+}
+
+void CRTIGateway::ioThread()
+{
+    std::shared_ptr<Request> req;
+    int nPollStep;
+    CStopWatch reconnectTimer;
+
+    // spread the poll commands over the poll interval
+    nPollStep = m_nPollInterval / (int)sizeof(pollCommands);
+    if(nPollStep < 1)
+        nPollStep = 1;
+
+    while(m_bRunning) {
+        if(!m_SerX.isConnected()) {
+            if(reconnectTimer.GetElapsedSeconds() < GATEWAY_RECONNECT_INTERVAL) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            else {
+                reconnectTimer.Reset();
+                m_SerX.open(m_Port.c_str(), 115200, SerXInterface::B_NOPARITY, "-DTR_CONTROL 1");
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_QueueMutex);
+            m_QueueCond.wait_for(lock, std::chrono::milliseconds(nPollStep), [this]{ return !m_Queue.empty() || !m_bRunning; });
+            if(!m_bRunning)
+                break;
+            if(m_Queue.empty()) {
+                req.reset();
+            }
+            else {
+                req = m_Queue.front();
+                req->bStarted = true;
+            }
+        }
+
+        if(!req) {
+            if(m_SerX.isConnected())
+                pollNext();
+            continue;
+        }
+
+        req->nErr = transact(req->sCmd, req->sResp);
+
+        if(isCacheable(req->sCmd)) {
+            if(!req->nErr && req->sResp[0] == req->sCmd[0]) {
+                std::lock_guard<std::mutex> lock(m_CacheMutex);
+                m_Cache[req->sCmd[0]].sResp = req->sResp;
+                m_Cache[req->sCmd[0]].timer.Reset();
+            }
+        }
+        else if(changesState(req->sCmd)) {
+            // something changed, don't trust the cache until the poller refreshes it
+            std::lock_guard<std::mutex> lock(m_CacheMutex);
+            m_Cache.clear();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            m_Queue.pop_front();
+            req->bDone = true;
+        }
+        m_DoneCond.notify_all();
+        req.reset();
+    }
+}
@@ -0,0 +1,86 @@
+//
+//  RTIGateway.h
+//  RTI-Gateway
+//
+//  Owns the connection to the RTI-Zone controller and shares it between many local clients.
+//  Status queries are answered from a cache kept up to date by a poller,
+//  everything else is sent to the controller one command at a time.
+//
+
+#ifndef __RTIGateway__
+#define __RTIGateway__
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+#include "../RTI-Dome.h"
+#include "PosixSerX.h"
+
+#define GATEWAY_POLL_INTERVAL   500     // ms between two refresh of the status cache
+#define GATEWAY_CACHE_MAX_AGE   2000    // ms, older cache entries are not used
+#define GATEWAY_CMD_TIMEOUT     MAX_TIMEOUT
+
+class CRTIGateway : public CRTIDome
+{
+public:
+    CRTIGateway();
+    ~CRTIGateway();
+
+    int         start(const std::string &sPort, int nPollInterval);
+    void        stop();
+
+    // sCmd is a full command without the trailing '#', sResp is the full response without the trailing '#'
+    int         query(const std::string &sCmd, std::string &sResp);
+
+    // stats
+    unsigned long   getCacheHits() { return m_nCacheHits; }
+    unsigned long   getDeviceCommands() { return m_nDeviceCommands; }
+    unsigned long   getCoalescedCommands() { return m_nCoalescedCommands; }
+
+protected:
+    typedef struct CacheEntry {
+        std::string     sResp;
+        CStopWatch      timer;
+    } CacheEntry;
+
+    typedef struct Request {
+        std::string     sCmd;
+        std::string     sResp;
+        int             nErr;
+        bool            bDone;
+        bool            bStarted;
+    } Request;
+
+    bool            isCacheable(const std::string &sCmd);
+    bool            changesState(const std::string &sCmd);
+    bool            isCoalescable(const std::string &sCmd);
+    int             transact(const std::string &sCmd, std::string &sResp);
+    void            ioThread();
+    void            pollNext();
+
+    CPosixSerX      m_SerX;
+    int             m_nPollInterval;
+
+    std::mutex      m_CacheMutex;
+    std::map<char, CacheEntry> m_Cache;
+
+    std::mutex      m_QueueMutex;
+    std::condition_variable m_QueueCond;
+    std::condition_variable m_DoneCond;
+    std::deque<std::shared_ptr<Request> > m_Queue;
+
+    std::thread     m_IoThread;
+    std::atomic<bool>   m_bRunning;
+    size_t          m_nPollIndex;
+    CStopWatch      m_PollTimer;
+
+    std::atomic<unsigned long>  m_nCacheHits;
+    std::atomic<unsigned long>  m_nDeviceCommands;
+    std::atomic<unsigned long>  m_nCoalescedCommands;
+};
+
+#endif
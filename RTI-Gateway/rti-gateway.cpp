@@ -0,0 +1,266 @@
+//
+//  rti-gateway.cpp
+//  RTI-Gateway
+//
+//  Daemon that owns the connection to the RTI-Zone controller and serves the same '#' terminated
+//  protocol to many local clients over TCP and a Unix socket.
+//  The X2 plugin can use it by connecting to the gateway TCP port instead of the controller.
+//
+//  Usage : rti-gateway -d port [-t tcp port] [-u unix socket path] [-i poll interval ms] [-v]
+//          port is a serial device (/dev/ttyACM0) or TCP:host:port
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <list>
+#include <memory>
+
+#include "RTIGateway.h"
+
+#define DEFAULT_TCP_PORT    2323
+#define DEFAULT_UNIX_SOCKET "/tmp/rti-dome.sock"
+
+static volatile sig_atomic_t bStop = 0;
+static bool bVerbose = false;
+static std::atomic<int> nbClients(0);
+
+// main owns the client sockets and threads so it can unblock and join them on shutdown
+typedef struct ClientSlot {
+    std::thread         thread;
+    int                 nFd;
+    std::atomic<bool>   bDone;
+} ClientSlot;
+
+static void signalHandler(int /* nSignal */)
+{
+    bStop = 1;
+}
+
+static int listenTcp(int nPort)
+{
+    int nFd;
+    int nFlag = 1;
+    struct sockaddr_in addr;
+
+    nFd = socket(AF_INET, SOCK_STREAM, 0);
+    if(nFd < 0)
+        return -1;
+    setsockopt(nFd, SOL_SOCKET, SO_REUSEADDR, &nFlag, sizeof(nFlag));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(nPort);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(bind(nFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(nFd, 16) < 0) {
+        close(nFd);
+        return -1;
+    }
+    return nFd;
+}
+
+static int listenUnix(const std::string &sPath)
+{
+    int nFd;
+    struct sockaddr_un addr;
+
+    nFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(nFd < 0)
+        return -1;
+    unlink(sPath.c_str());
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sPath.c_str(), sizeof(addr.sun_path) - 1);
+    if(bind(nFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(nFd, 16) < 0) {
+        close(nFd);
+        return -1;
+    }
+    return nFd;
+}
+
+static void clientThread(CRTIGateway *pGateway, ClientSlot *pClient)
+{
+    int nFd = pClient->nFd;
+    char buffer[SERIAL_BUFFER_SIZE];
+    ssize_t nRead;
+    ssize_t i;
+    std::string sCmd;
+    std::string sTag;
+    std::string sResp;
+    int nErr;
+
+    nbClients++;
+    if(bVerbose)
+        fprintf(stderr, "client connected, %d clients\n", nbClients.load());
+
+    while(!bStop) {
+        nRead = read(nFd, buffer, sizeof(buffer));
+        if(nRead < 0 && errno == EINTR)
+            continue;
+        if(nRead <= 0)
+            break;
+        for(i = 0; i < nRead; i++) {
+            // same terminators as the firmware
+            if(buffer[i] == '#' || buffer[i] == '\r' || buffer[i] == '\n') {
+                if(sCmd.empty())
+                    continue;
+                // tagged frame (~xx<command>), the tag is ours to send back, not part of the command
+                sTag.clear();
+                if(sCmd[0] == '~' && sCmd.size() > 3) {
+                    sTag = sCmd.substr(0, 3);
+                    sCmd.erase(0, 3);
+                }
+                // we only speak ASCII to our clients, refuse binary frames
+                if(sCmd[0] == 'B') {
+                    sResp = "B0";
+                    nErr = PLUGIN_OK;
+                }
+                else
+                    nErr = pGateway->query(sCmd, sResp);
+                if(bVerbose)
+                    fprintf(stderr, "%s%s -> %s (%d)\n", sTag.c_str(), sCmd.c_str(), sResp.c_str(), nErr);
+                // on error don't answer, the client will time out as if talking to the controller
+                if(!nErr) {
+                    sResp = sTag + sResp + "#";
+                    if(write(nFd, sResp.c_str(), sResp.size()) < 0)
+                        break;
+                }
+                sCmd.clear();
+            }
+            else if(sCmd.size() < SERIAL_BUFFER_SIZE) {
+                sCmd += buffer[i];
+            }
+        }
+    }
+    nbClients--;
+    if(bVerbose)
+        fprintf(stderr, "client disconnected, %d clients\n", nbClients.load());
+    pClient->bDone = true;
+}
+
+// join the threads of the clients that went away, or all of them when bAll is set
+static void reapClients(std::list<std::unique_ptr<ClientSlot>> &clients, bool bAll)
+{
+    std::list<std::unique_ptr<ClientSlot>>::iterator it;
+
+    for(it = clients.begin(); it != clients.end(); ) {
+        if(bAll)
+            shutdown((*it)->nFd, SHUT_RDWR); // wakes up the read in clientThread
+        if(!bAll && !(*it)->bDone) {
+            ++it;
+            continue;
+        }
+        (*it)->thread.join();
+        close((*it)->nFd);
+        it = clients.erase(it);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int nErr;
+    int nOpt;
+    int nTcpPort = DEFAULT_TCP_PORT;
+    int nPollInterval = GATEWAY_POLL_INTERVAL;
+    int nFlag = 1;
+    int nFd;
+    std::string sDevice;
+    std::string sUnixPath = DEFAULT_UNIX_SOCKET;
+    struct pollfd pfds[2];
+    int nbFds = 0;
+    int i;
+    CRTIGateway gateway;
+    std::list<std::unique_ptr<ClientSlot>> clients;
+    ClientSlot *pClient;
+
+    while((nOpt = getopt(argc, argv, "d:t:u:i:vh")) != -1) {
+        switch(nOpt) {
+            case 'd':
+                sDevice = optarg;
+                break;
+            case 't':
+                nTcpPort = atoi(optarg);
+                break;
+            case 'u':
+                sUnixPath = optarg;
+                break;
+            case 'i':
+                nPollInterval = atoi(optarg);
+                break;
+            case 'v':
+                bVerbose = true;
+                break;
+            default:
+                break;
+        }
+    }
+    if(sDevice.empty()) {
+        fprintf(stderr, "Usage : %s -d port [-t tcp port, 0 to disable] [-u unix socket path, empty to disable] [-i poll interval ms] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+    signal(SIGPIPE, SIG_IGN);
+
+    nErr = gateway.start(sDevice, nPollInterval);
+    if(nErr) {
+        fprintf(stderr, "Error connecting to %s : %d\n", sDevice.c_str(), nErr);
+        return 1;
+    }
+
+    if(nTcpPort > 0) {
+        pfds[nbFds].fd = listenTcp(nTcpPort);
+        if(pfds[nbFds].fd < 0) {
+            perror("Error opening TCP port");
+            return 1;
+        }
+        pfds[nbFds++].events = POLLIN;
+    }
+    if(!sUnixPath.empty()) {
+        pfds[nbFds].fd = listenUnix(sUnixPath);
+        if(pfds[nbFds].fd < 0) {
+            perror("Error opening Unix socket");
+            return 1;
+        }
+        pfds[nbFds++].events = POLLIN;
+    }
+
+    while(!bStop) {
+        reapClients(clients, false);
+        if(poll(pfds, nbFds, 1000) <= 0)
+            continue;
+        for(i = 0; i < nbFds; i++) {
+            if(!(pfds[i].revents & POLLIN))
+                continue;
+            nFd = accept(pfds[i].fd, NULL, NULL);
+            if(nFd < 0)
+                continue;
+            setsockopt(nFd, IPPROTO_TCP, TCP_NODELAY, &nFlag, sizeof(nFlag)); // fails silently on Unix sockets
+            pClient = new ClientSlot;
+            pClient->nFd = nFd;
+            pClient->bDone = false;
+            clients.push_back(std::unique_ptr<ClientSlot>(pClient));
+            pClient->thread = std::thread(clientThread, &gateway, pClient);
+        }
+    }
+
+    if(bVerbose)
+        fprintf(stderr, "cache hits %lu, device commands %lu, coalesced commands %lu\n",
+                gateway.getCacheHits(), gateway.getDeviceCommands(), gateway.getCoalescedCommands());
+
+    for(i = 0; i < nbFds; i++)
+        close(pfds[i].fd);
+    if(!sUnixPath.empty())
+        unlink(sUnixPath.c_str());
+    reapClients(clients, true);
+    gateway.stop();
+    return 0;
+}
@@ -0,0 +1,255 @@
+//
+//  azimuth-math-test.cpp
+//  RTI-Dome
+//
+//  Host test and benchmark of the rotator fixed point azimuth math (Hardware/Firmwares/RotatorEth/AzimuthMath.h).
+//  Checks every position against a double reference for a few steps per rotation values, the step / azimuth
+//  round trip and parseCentiDeg, compares them with the float GetAzimuth and GetAzimuthToPosition they replaced,
+//  then times the fixed point conversion against the float one.
+//  The timing is only indicative, the host has an FPU and the Due doesn't.
+//  Usage : azimuth-math-test [-n benchmark loops]
+//  Returns 0 if all the checks pass.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "AzimuthMath.h"
+
+// typical steps per rotation of RTI-Zone / NexDome rotators plus a few odd ones
+static const long stepsPerRotationValues[] = {1, 7, 36000, 55080, 123457, 440640, 1000003};
+
+static int nFailures = 0;
+
+static void fail(const char *pszTest, long nSteps, long nInput, long nExpected, long nResult)
+{
+    if(nFailures++ < 20)
+        fprintf(stderr, "%s failed : steps per rotation %ld, input %ld, expected %ld, got %ld\n", pszTest, nSteps, nInput, nExpected, nResult);
+}
+
+// what the conversion should give, rounded to nearest
+static long referenceCentiDeg(long nPosition, long nSteps)
+{
+    return (long)floor((double)nPosition * CENTIDEG_PER_TURN / nSteps + 0.5) % CENTIDEG_PER_TURN;
+}
+
+// the float code GetAzimuth used before the fixed point one
+static float floatAzimuth(long nPosition, long nSteps)
+{
+    double azimuth = 0.0;
+
+    if (nPosition != 0)
+        azimuth = (double)nPosition / (double)nSteps * 360.0;
+    while (azimuth < 0.0)
+        azimuth += 360.0;
+    while (azimuth >= 360.0)
+        azimuth -= 360.0;
+    return float(azimuth);
+}
+
+// the float code GetAzimuthToPosition used before, it truncated and didn't wrap
+static long floatAzimuthToPosition(float fAzimuth, long nSteps)
+{
+    long newPosition;
+
+    newPosition = (float)nSteps / (float)360 * fAzimuth;
+    return newPosition;
+}
+
+// how far apart two positions are on the dome circle
+static long circularDistance(long nPosition1, long nPosition2, long nSteps)
+{
+    long nDelta;
+
+    nDelta = (((nPosition1 - nPosition2) % nSteps) + nSteps) % nSteps;
+    return nDelta > nSteps / 2 ? nSteps - nDelta : nDelta;
+}
+
+static void testWrapSteps(long nSteps)
+{
+    long nPosition;
+    long nResult;
+    long nExpected;
+
+    for(nPosition = -3 * nSteps; nPosition <= 3 * nSteps; nPosition += (nSteps / 1000) + 1) {
+        nResult = wrapSteps(nPosition, nSteps);
+        nExpected = ((nPosition % nSteps) + nSteps) % nSteps;
+        if(nResult != nExpected)
+            fail("wrapSteps", nSteps, nPosition, nExpected, nResult);
+    }
+    // no steps per rotation yet, the position is left alone
+    if(wrapSteps(-12, 0) != -12)
+        fail("wrapSteps", 0, -12, -12, wrapSteps(-12, 0));
+}
+
+static void testStepsToCentiDeg(long nSteps)
+{
+    long nPosition;
+    long nResult;
+    long nExpected;
+
+    for(nPosition = 0; nPosition < nSteps; nPosition++) {
+        nResult = stepsToCentiDeg(nPosition, nSteps);
+        nExpected = referenceCentiDeg(nPosition, nSteps);
+        if(nResult != nExpected)
+            fail("stepsToCentiDeg", nSteps, nPosition, nExpected, nResult);
+        // same answer a few turns away in either direction
+        if(stepsToCentiDeg(nPosition - 2 * nSteps, nSteps) != nResult)
+            fail("stepsToCentiDeg (negative)", nSteps, nPosition - 2 * nSteps, nResult, stepsToCentiDeg(nPosition - 2 * nSteps, nSteps));
+        if(stepsToCentiDeg(nPosition + nSteps, nSteps) != nResult)
+            fail("stepsToCentiDeg (next turn)", nSteps, nPosition + nSteps, nResult, stepsToCentiDeg(nPosition + nSteps, nSteps));
+    }
+}
+
+static void testCentiDegToSteps(long nSteps)
+{
+    long nCentiDeg;
+    long nPosition;
+    long nExpected;
+
+    for(nCentiDeg = -CENTIDEG_PER_TURN; nCentiDeg < 2 * CENTIDEG_PER_TURN; nCentiDeg++) {
+        nPosition = centiDegToSteps(nCentiDeg, nSteps);
+        nExpected = (long)floor((double)(((nCentiDeg % CENTIDEG_PER_TURN) + CENTIDEG_PER_TURN) % CENTIDEG_PER_TURN) * nSteps / CENTIDEG_PER_TURN + 0.5);
+        if(nPosition != nExpected)
+            fail("centiDegToSteps", nSteps, nCentiDeg, nExpected, nPosition);
+        // with at least one step per 1/100 degree the round trip is exact
+        nExpected = ((nCentiDeg % CENTIDEG_PER_TURN) + CENTIDEG_PER_TURN) % CENTIDEG_PER_TURN;
+        if(nSteps >= CENTIDEG_PER_TURN && stepsToCentiDeg(nPosition, nSteps) != nExpected)
+            fail("centiDegToSteps round trip", nSteps, nCentiDeg, nExpected, stepsToCentiDeg(nPosition, nSteps));
+    }
+}
+
+// the old GetAzimuth gave the exact azimuth as a float, we round it to 1/100 degree
+static void testAgainstFloatAzimuth(long nSteps)
+{
+    long nPosition;
+    long nResult;
+    long nIncrement;
+    double dDelta;
+    float fAzimuth;
+
+    nIncrement = (nSteps / 5000) + 1;
+    // a couple of turns either way, the turn boundaries are hit as nSteps is a multiple of nIncrement or close to it
+    for(nPosition = -2 * nSteps - 2; nPosition <= 2 * nSteps + 2; nPosition += nIncrement) {
+        nResult = stepsToCentiDeg(nPosition, nSteps);
+        fAzimuth = floatAzimuth(nPosition, nSteps);
+        dDelta = fabs(nResult / 100.0 - fAzimuth);
+        if(dDelta > 180.0)
+            dDelta = 360.0 - dDelta;
+        if(dDelta > 0.005 + 0.0001)
+            fail("stepsToCentiDeg vs float GetAzimuth", nSteps, nPosition, (long)floor(fAzimuth * 100.0 + 0.5), nResult);
+    }
+}
+
+// what a sync or goto string gave before, value.toFloat() then GetAzimuthToPosition, and now, parseCentiDeg then centiDegToSteps.
+// The float code truncated so it can be one step short, and gave negative or beyond a turn positions for azimuths out of 0-360.
+static void testAgainstFloatAzimuthToPosition(long nSteps)
+{
+    long nCentiDeg;
+    long nResult;
+    long nExpected;
+    char szValue[32];
+
+    for(nCentiDeg = -CENTIDEG_PER_TURN - 3; nCentiDeg <= 2 * CENTIDEG_PER_TURN + 3; nCentiDeg++) {
+        snprintf(szValue, sizeof(szValue), "%s%ld.%02ld", nCentiDeg < 0 ? "-" : "", labs(nCentiDeg) / 100, labs(nCentiDeg) % 100);
+        nResult = centiDegToSteps(parseCentiDeg(szValue), nSteps);
+        nExpected = floatAzimuthToPosition((float)atof(szValue), nSteps);
+        if(circularDistance(nResult, nExpected, nSteps) > 1)
+            fail("centiDegToSteps vs float GetAzimuthToPosition", nSteps, nCentiDeg, nExpected, nResult);
+    }
+}
+
+static void testParseCentiDeg()
+{
+    static const struct {
+        const char *pszValue;
+        long nExpected;
+    } cases[] = {
+        {"0", 0}, {"90", 9000}, {"123.45", 12345}, {"359.99", 35999}, {"7.1", 710}, {"7.", 700}, {".5", 50},
+        {"12.344", 1234}, {"12.345", 1235}, {"1.999", 200}, {"-1.5", -150}, {"-0.01", -1}, {"45.00#", 4500},
+        {"180.5,2", 18050}, {"", 0}
+    };
+    char szValue[32];
+    long nCentiDeg;
+    size_t i;
+
+    for(i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if(parseCentiDeg(cases[i].pszValue) != cases[i].nExpected) {
+            if(nFailures++ < 20)
+                fprintf(stderr, "parseCentiDeg failed : \"%s\", expected %ld, got %ld\n", cases[i].pszValue, cases[i].nExpected, parseCentiDeg(cases[i].pszValue));
+        }
+    }
+    // everything formatCentiDeg can send back
+    for(nCentiDeg = 0; nCentiDeg < CENTIDEG_PER_TURN; nCentiDeg++) {
+        snprintf(szValue, sizeof(szValue), "%ld.%02ld", nCentiDeg / 100, nCentiDeg % 100);
+        if(parseCentiDeg(szValue) != nCentiDeg)
+            fail("parseCentiDeg", 0, nCentiDeg, nCentiDeg, parseCentiDeg(szValue));
+    }
+}
+
+static void benchmark(long nLoops)
+{
+    const long nSteps = 440640;
+    long nPosition;
+    long nLoop;
+    volatile long nSum = 0;
+    volatile float fSum = 0;
+    double dFixed;
+    double dFloat;
+    std::chrono::steady_clock::time_point start;
+
+    start = std::chrono::steady_clock::now();
+    for(nLoop = 0; nLoop < nLoops; nLoop++)
+        for(nPosition = 0; nPosition < nSteps; nPosition += 97)
+            nSum = nSum + stepsToCentiDeg(nPosition + nLoop, nSteps);
+    dFixed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for(nLoop = 0; nLoop < nLoops; nLoop++)
+        for(nPosition = 0; nPosition < nSteps; nPosition += 97)
+            fSum = fSum + floatAzimuth(nPosition + nLoop, nSteps);
+    dFloat = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    nLoops *= (nSteps + 96) / 97;
+    printf("stepsToCentiDeg : %.1f ns per call, float GetAzimuth : %.1f ns per call\n", dFixed / nLoops, dFloat / nLoops);
+}
+
+int main(int argc, char **argv)
+{
+    int nOpt;
+    long nLoops = 100;
+    size_t i;
+
+    while((nOpt = getopt(argc, argv, "n:h")) != -1) {
+        switch(nOpt) {
+            case 'n':
+                nLoops = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage : %s [-n benchmark loops]\n", argv[0]);
+                return nOpt == 'h' ? 0 : 1;
+        }
+    }
+
+    for(i = 0; i < sizeof(stepsPerRotationValues) / sizeof(stepsPerRotationValues[0]); i++) {
+        testWrapSteps(stepsPerRotationValues[i]);
+        testStepsToCentiDeg(stepsPerRotationValues[i]);
+        testCentiDegToSteps(stepsPerRotationValues[i]);
+        testAgainstFloatAzimuth(stepsPerRotationValues[i]);
+        testAgainstFloatAzimuthToPosition(stepsPerRotationValues[i]);
+    }
+    testParseCentiDeg();
+
+    if(nFailures) {
+        printf("%d checks failed\n", nFailures);
+        return 1;
+    }
+    printf("all checks passed\n");
+
+    if(nLoops > 0)
+        benchmark(nLoops);
+    return 0;
+}
@@ -0,0 +1,266 @@
+//
+//  rti-load.cpp
+//  RTI-Dome
+//
+//  Load generator for rti-gateway (or a controller on the network) : N clients send the same '#' terminated
+//  commands one at a time, each waiting for its reply, and the per command latency is printed at the end.
+//  With -b each client writes all its commands in one go before reading the replies, to see how the other
+//  side copes with requests arriving back to back.
+//  Usage : rti-load [-a address] [-p port | -u unix socket] [-c clients] [-n commands per client] [-b] [commands]
+//          commands is a comma separated list without the '#', the default is the gateway poll set g,m,z,M,k,K,o,F
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+#define DEFAULT_ADDRESS     "127.0.0.1"
+#define DEFAULT_TCP_PORT    2323    // rti-gateway default, the controller listens on 2323 too
+#define DEFAULT_COMMANDS    "g,m,z,M,k,K,o,F"
+#define REPLY_TIMEOUT       5000    // ms
+
+typedef struct LoadConfig {
+    std::string                 sAddress;
+    int                         nPort;
+    std::string                 sUnixPath;
+    int                         nCommands;
+    bool                        bBurst;
+    std::vector<std::string>    svCommands;
+} LoadConfig;
+
+static std::mutex resultsMutex;
+static std::map<std::string, std::vector<double> > latencies; // us, per command
+static unsigned long nErrors = 0;
+
+static int connectTo(const LoadConfig &config)
+{
+    int nFd;
+    int nFlag = 1;
+    struct sockaddr_un unixAddr;
+    struct addrinfo hints;
+    struct addrinfo *pAddr = NULL;
+
+    if(!config.sUnixPath.empty()) {
+        nFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(nFd < 0)
+            return -1;
+        memset(&unixAddr, 0, sizeof(unixAddr));
+        unixAddr.sun_family = AF_UNIX;
+        strncpy(unixAddr.sun_path, config.sUnixPath.c_str(), sizeof(unixAddr.sun_path) - 1);
+        if(connect(nFd, (struct sockaddr *)&unixAddr, sizeof(unixAddr)) < 0) {
+            close(nFd);
+            return -1;
+        }
+        return nFd;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(config.sAddress.c_str(), std::to_string(config.nPort).c_str(), &hints, &pAddr) || !pAddr)
+        return -1;
+    nFd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+    if(nFd >= 0 && connect(nFd, pAddr->ai_addr, pAddr->ai_addrlen) < 0) {
+        close(nFd);
+        nFd = -1;
+    }
+    freeaddrinfo(pAddr);
+    if(nFd >= 0)
+        setsockopt(nFd, IPPROTO_TCP, TCP_NODELAY, &nFlag, sizeof(nFlag));
+    return nFd;
+}
+
+// read one '#' terminated reply, sBuffer keeps what we read past it
+static bool readReply(int nFd, std::string &sBuffer, std::string &sReply)
+{
+    char buffer[256];
+    ssize_t nRead;
+    size_t nPos;
+    struct pollfd pfd;
+
+    while((nPos = sBuffer.find('#')) == std::string::npos) {
+        pfd.fd = nFd;
+        pfd.events = POLLIN;
+        if(poll(&pfd, 1, REPLY_TIMEOUT) <= 0)
+            return false;
+        nRead = read(nFd, buffer, sizeof(buffer));
+        if(nRead <= 0)
+            return false;
+        sBuffer.append(buffer, nRead);
+    }
+    sReply = sBuffer.substr(0, nPos);
+    sBuffer.erase(0, nPos + 1);
+    return true;
+}
+
+static void clientThread(const LoadConfig &config, int nClient)
+{
+    int nFd;
+    int i;
+    std::string sBuffer;
+    std::string sReply;
+    std::string sRequests;
+    std::vector<std::string> svSent;
+    std::map<std::string, std::vector<double> > localLatencies;
+    unsigned long nLocalErrors = 0;
+    std::chrono::steady_clock::time_point start;
+
+    nFd = connectTo(config);
+    if(nFd < 0) {
+        fprintf(stderr, "client %d : can't connect\n", nClient);
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        nErrors += config.nCommands;
+        return;
+    }
+
+    // each client starts at a different place in the list so they don't all ask the same thing at once
+    for(i = 0; i < config.nCommands; i++)
+        svSent.push_back(config.svCommands[(i + nClient) % config.svCommands.size()]);
+
+    if(config.bBurst) {
+        // the latency is from the single write to each reply
+        for(const std::string &sCmd : svSent)
+            sRequests += sCmd + "#";
+        start = std::chrono::steady_clock::now();
+        if(write(nFd, sRequests.c_str(), sRequests.size()) < 0)
+            nLocalErrors += svSent.size();
+        else {
+            for(const std::string &sCmd : svSent) {
+                if(!readReply(nFd, sBuffer, sReply) || sReply.empty() || sReply[0] != sCmd[0]) {
+                    nLocalErrors++;
+                    continue;
+                }
+                localLatencies[sCmd].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+    }
+    else {
+        for(const std::string &sCmd : svSent) {
+            sRequests = sCmd + "#";
+            start = std::chrono::steady_clock::now();
+            if(write(nFd, sRequests.c_str(), sRequests.size()) < 0 || !readReply(nFd, sBuffer, sReply) ||
+               sReply.empty() || sReply[0] != sCmd[0]) {
+                nLocalErrors++;
+                continue;
+            }
+            localLatencies[sCmd].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+    close(nFd);
+
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    for(auto &entry : localLatencies)
+        latencies[entry.first].insert(latencies[entry.first].end(), entry.second.begin(), entry.second.end());
+    nErrors += nLocalErrors;
+}
+
+static double percentile(const std::vector<double> &dvSorted, double dPercent)
+{
+    size_t nIndex;
+
+    nIndex = (size_t)(dPercent / 100.0 * (dvSorted.size() - 1) + 0.5);
+    return dvSorted[nIndex];
+}
+
+int main(int argc, char **argv)
+{
+    int nOpt;
+    int nClients = 4;
+    int i;
+    size_t nStart;
+    size_t nEnd;
+    unsigned long nReplies = 0;
+    double dSeconds;
+    double dSum;
+    std::string sCommands = DEFAULT_COMMANDS;
+    std::vector<std::thread> threads;
+    std::vector<double> dvAll;
+    std::chrono::steady_clock::time_point start;
+    LoadConfig config;
+
+    config.sAddress = DEFAULT_ADDRESS;
+    config.nPort = DEFAULT_TCP_PORT;
+    config.nCommands = 100;
+    config.bBurst = false;
+
+    while((nOpt = getopt(argc, argv, "a:p:u:c:n:bh")) != -1) {
+        switch(nOpt) {
+            case 'a':
+                config.sAddress = optarg;
+                break;
+            case 'p':
+                config.nPort = atoi(optarg);
+                break;
+            case 'u':
+                config.sUnixPath = optarg;
+                break;
+            case 'c':
+                nClients = atoi(optarg);
+                break;
+            case 'n':
+                config.nCommands = atoi(optarg);
+                break;
+            case 'b':
+                config.bBurst = true;
+                break;
+            default:
+                fprintf(stderr, "Usage : %s [-a address] [-p port | -u unix socket] [-c clients] [-n commands per client] [-b] [commands]\n", argv[0]);
+                return nOpt == 'h' ? 0 : 1;
+        }
+    }
+    if(optind < argc)
+        sCommands = argv[optind];
+    for(nStart = 0; nStart < sCommands.size(); nStart = nEnd + 1) {
+        nEnd = sCommands.find(',', nStart);
+        if(nEnd == std::string::npos)
+            nEnd = sCommands.size();
+        if(nEnd > nStart)
+            config.svCommands.push_back(sCommands.substr(nStart, nEnd - nStart));
+    }
+    if(config.svCommands.empty() || nClients < 1 || config.nCommands < 1) {
+        fprintf(stderr, "nothing to send\n");
+        return 1;
+    }
+
+    start = std::chrono::steady_clock::now();
+    for(i = 0; i < nClients; i++)
+        threads.push_back(std::thread(clientThread, std::cref(config), i));
+    for(std::thread &thread : threads)
+        thread.join();
+    dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%d clients, %d commands each%s, %.2f s\n", nClients, config.nCommands, config.bBurst ? " in one write" : "", dSeconds);
+    printf("%-8s %8s %10s %10s %10s %10s %10s\n", "command", "replies", "min us", "avg us", "p50 us", "p95 us", "max us");
+    for(auto &entry : latencies) {
+        std::sort(entry.second.begin(), entry.second.end());
+        dSum = 0;
+        for(double dLatency : entry.second)
+            dSum += dLatency;
+        printf("%-8s %8zu %10.0f %10.0f %10.0f %10.0f %10.0f\n", entry.first.c_str(), entry.second.size(), entry.second.front(),
+               dSum / entry.second.size(), percentile(entry.second, 50), percentile(entry.second, 95), entry.second.back());
+        nReplies += entry.second.size();
+        dvAll.insert(dvAll.end(), entry.second.begin(), entry.second.end());
+    }
+    if(!dvAll.empty()) {
+        std::sort(dvAll.begin(), dvAll.end());
+        printf("%-8s %8zu %10.0f %10s %10.0f %10.0f %10.0f\n", "all", dvAll.size(), dvAll.front(), "",
+               percentile(dvAll, 50), percentile(dvAll, 95), dvAll.back());
+    }
+    printf("%lu replies/s, %lu errors\n", (unsigned long)(nReplies / dSeconds), nErrors);
+    return nErrors ? 1 : 0;
+}
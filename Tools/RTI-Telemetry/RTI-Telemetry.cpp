@@ -0,0 +1,155 @@
+//
+//  RTI-Telemetry.cpp
+//  RTI-Dome
+//
+//  Listener for the UDP telemetry sent by the RTI-Zone rotator firmware (command U).
+//
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "RTI-Telemetry.h"
+
+CRTITelemetry::CRTITelemetry()
+{
+    m_nSocket = -1;
+    m_bHaveSequence = false;
+    m_nLastSequence = 0;
+    m_nLostPackets = 0;
+}
+
+CRTITelemetry::~CRTITelemetry()
+{
+    close();
+}
+
+int CRTITelemetry::open(const std::string &sAddress, int nPort)
+{
+    struct sockaddr_in localAddr;
+    struct ip_mreq mreq;
+    struct in_addr addr;
+    int nReuse = 1;
+
+    close();
+
+    m_nSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if(m_nSocket < 0)
+        return TELEMETRY_SOCKET_ERROR;
+
+    // allow more than one listener on the same machine
+    setsockopt(m_nSocket, SOL_SOCKET, SO_REUSEADDR, &nReuse, sizeof(nReuse));
+
+    memset(&localAddr, 0, sizeof(localAddr));
+    localAddr.sin_family = AF_INET;
+    localAddr.sin_port = htons(nPort);
+    localAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(bind(m_nSocket, (struct sockaddr *)&localAddr, sizeof(localAddr)) < 0) {
+        close();
+        return TELEMETRY_SOCKET_ERROR;
+    }
+
+    if(!sAddress.empty()) {
+        if(inet_pton(AF_INET, sAddress.c_str(), &addr) != 1) {
+            close();
+            return TELEMETRY_SOCKET_ERROR;
+        }
+        if(IN_MULTICAST(ntohl(addr.s_addr))) {
+            mreq.imr_multiaddr = addr;
+            mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+            if(setsockopt(m_nSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+                close();
+                return TELEMETRY_SOCKET_ERROR;
+            }
+        }
+    }
+
+    m_bHaveSequence = false;
+    m_nLostPackets = 0;
+    return TELEMETRY_OK;
+}
+
+void CRTITelemetry::close()
+{
+    if(m_nSocket >= 0)
+        ::close(m_nSocket);
+    m_nSocket = -1;
+}
+
+int CRTITelemetry::receive(RTITelemetry &data, int nTimeoutMs)
+{
+    int nErr;
+    uint8_t buffer[256];
+    ssize_t nLen;
+    struct pollfd pfd;
+
+    if(m_nSocket < 0)
+        return TELEMETRY_SOCKET_ERROR;
+
+    pfd.fd = m_nSocket;
+    pfd.events = POLLIN;
+    nErr = poll(&pfd, 1, nTimeoutMs);
+    if(nErr < 0)
+        return (errno == EINTR) ? TELEMETRY_TIMEOUT : TELEMETRY_SOCKET_ERROR;
+    if(nErr == 0)
+        return TELEMETRY_TIMEOUT;
+
+    nLen = recv(m_nSocket, buffer, sizeof(buffer), 0);
+    if(nLen < 0)
+        return TELEMETRY_SOCKET_ERROR;
+
+    nErr = decode(buffer, (size_t)nLen, data);
+    if(nErr)
+        return nErr;
+
+    if(m_bHaveSequence && data.nSequence > m_nLastSequence + 1)
+        m_nLostPackets += data.nSequence - m_nLastSequence - 1;
+    m_nLastSequence = data.nSequence;
+    m_bHaveSequence = true;
+    data.nLostPackets = m_nLostPackets;
+
+    return TELEMETRY_OK;
+}
+
+static uint16_t getLE16(const uint8_t *pBuffer)
+{
+    return (uint16_t)(pBuffer[0] | (pBuffer[1] << 8));
+}
+
+static uint32_t getLE32(const uint8_t *pBuffer)
+{
+    return (uint32_t)pBuffer[0] | ((uint32_t)pBuffer[1] << 8) | ((uint32_t)pBuffer[2] << 16) | ((uint32_t)pBuffer[3] << 24);
+}
+
+int CRTITelemetry::decode(const uint8_t *pBuffer, size_t nLen, RTITelemetry &data)
+{
+    if(nLen < TELEMETRY_PACKET_SIZE)
+        return TELEMETRY_BAD_PACKET;
+    if(getLE32(pBuffer) != TELEMETRY_MAGIC)
+        return TELEMETRY_BAD_PACKET;
+    if(pBuffer[4] != TELEMETRY_VERSION)
+        return TELEMETRY_BAD_PACKET;
+
+    memset(&data, 0, sizeof(data));
+    data.nVersion = pBuffer[4];
+    data.nFlags = pBuffer[5];
+    data.nSeekMode = pBuffer[6];
+    data.nDirection = (int8_t)pBuffer[7];
+    data.nSequence = getLE32(pBuffer + 8);
+    data.nUptimeMs = getLE32(pBuffer + 12);
+    data.dAzimuth = (int32_t)getLE32(pBuffer + 16) / 100.0;
+    data.nPosition = (int32_t)getLE32(pBuffer + 20);
+    data.dRotatorVolts = getLE16(pBuffer + 24) / 100.0;
+    data.dShutterVolts = getLE16(pBuffer + 26) / 100.0;
+    data.nShutterState = pBuffer[28];
+    data.nTcpClients = pBuffer[29];
+    data.nLoopAvgUs = getLE16(pBuffer + 30);
+    data.nLoopMaxUs = getLE16(pBuffer + 32);
+    data.nLoopCount = getLE32(pBuffer + 34);
+
+    return TELEMETRY_OK;
+}
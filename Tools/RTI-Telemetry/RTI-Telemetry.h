@@ -0,0 +1,79 @@
+//
+//  RTI-Telemetry.h
+//  RTI-Dome
+//
+//  Listener for the UDP telemetry sent by the RTI-Zone rotator firmware (command U).
+//  This lets dashboards and monitoring get the dome status without using the TCP control connection.
+//
+
+#ifndef __RTI_Telemetry__
+#define __RTI_Telemetry__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define TELEMETRY_DEFAULT_GROUP     "239.255.42.42"
+#define TELEMETRY_DEFAULT_PORT      2324
+
+#define TELEMETRY_MAGIC             0x54495452  // 'RTIT'
+#define TELEMETRY_VERSION           2
+#define TELEMETRY_PACKET_SIZE       40
+
+#define TELEMETRY_FLAG_MOVING           0x01
+#define TELEMETRY_FLAG_AT_HOME          0x02
+#define TELEMETRY_FLAG_RAINING          0x04
+#define TELEMETRY_FLAG_SHUTTER_PRESENT  0x08
+#define TELEMETRY_FLAG_SHUTTER_LOW_VOLTS 0x10
+#define TELEMETRY_FLAG_HAS_CONTROLLER   0x20
+
+// same values as ShutterStates in the shutter firmware
+enum TelemetryShutterState { TELEMETRY_SHUTTER_OPEN, TELEMETRY_SHUTTER_CLOSED, TELEMETRY_SHUTTER_OPENING, TELEMETRY_SHUTTER_CLOSING,
+                             TELEMETRY_SHUTTER_BOTTOM_OPEN, TELEMETRY_SHUTTER_BOTTOM_CLOSED, TELEMETRY_SHUTTER_BOTTOM_OPENING, TELEMETRY_SHUTTER_BOTTOM_CLOSING,
+                             TELEMETRY_SHUTTER_ERROR, TELEMETRY_SHUTTER_FINISHING_OPEN, TELEMETRY_SHUTTER_FINISHING_CLOSE,
+                             TELEMETRY_SHUTTER_UNKNOWN = 0xFF };
+
+enum RTITelemetryErrors {TELEMETRY_OK=0, TELEMETRY_SOCKET_ERROR, TELEMETRY_TIMEOUT, TELEMETRY_BAD_PACKET};
+
+typedef struct RTITelemetryData {
+    int         nVersion;
+    int         nFlags;
+    int         nSeekMode;
+    int         nDirection;
+    uint32_t    nSequence;
+    uint32_t    nUptimeMs;
+    double      dAzimuth;
+    int32_t     nPosition;
+    double      dRotatorVolts;
+    double      dShutterVolts;
+    int         nShutterState;
+    int         nTcpClients;
+    int         nLoopAvgUs;
+    int         nLoopMaxUs;
+    uint32_t    nLoopCount;
+    uint32_t    nLostPackets;   // computed by the listener from the sequence numbers
+} RTITelemetry;
+
+class CRTITelemetry
+{
+public:
+    CRTITelemetry();
+    ~CRTITelemetry();
+
+    // sAddress can be a multicast group or a local address (or empty) for unicast
+    int         open(const std::string &sAddress, int nPort);
+    void        close();
+    bool        isOpen() { return m_nSocket >= 0; }
+
+    int         receive(RTITelemetry &data, int nTimeoutMs);
+
+    static int  decode(const uint8_t *pBuffer, size_t nLen, RTITelemetry &data);
+
+private:
+    int         m_nSocket;
+    bool        m_bHaveSequence;
+    uint32_t    m_nLastSequence;
+    uint32_t    m_nLostPackets;
+};
+
+#endif
@@ -0,0 +1,88 @@
+//
+//  rti-telemetry.cpp
+//  RTI-Dome
+//
+//  Print the UDP telemetry sent by the RTI-Zone rotator firmware, one line per packet.
+//  Usage : rti-telemetry [-a address] [-p port] [-n count]
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "RTI-Telemetry.h"
+
+static const char *shutterStateName(int nState)
+{
+    static const char *names[] = {"open", "closed", "opening", "closing",
+                                  "bottom_open", "bottom_closed", "bottom_opening", "bottom_closing",
+                                  "error", "finishing_open", "finishing_close"};
+    if(nState >= TELEMETRY_SHUTTER_OPEN && nState <= TELEMETRY_SHUTTER_FINISHING_CLOSE)
+        return names[nState];
+    return "unknown";
+}
+
+int main(int argc, char **argv)
+{
+    int nErr;
+    int nOpt;
+    int nPort = TELEMETRY_DEFAULT_PORT;
+    long nCount = -1;
+    std::string sAddress = TELEMETRY_DEFAULT_GROUP;
+    CRTITelemetry listener;
+    RTITelemetry data;
+
+    while((nOpt = getopt(argc, argv, "a:p:n:h")) != -1) {
+        switch(nOpt) {
+            case 'a':
+                sAddress = optarg;
+                break;
+            case 'p':
+                nPort = atoi(optarg);
+                break;
+            case 'n':
+                nCount = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage : %s [-a multicast group or local address] [-p port] [-n count]\n", argv[0]);
+                return nOpt == 'h' ? 0 : 1;
+        }
+    }
+
+    nErr = listener.open(sAddress, nPort);
+    if(nErr) {
+        perror("Error opening telemetry socket");
+        return 1;
+    }
+
+    while(nCount != 0) {
+        nErr = listener.receive(data, 1000);
+        if(nErr == TELEMETRY_TIMEOUT)
+            continue;
+        if(nErr == TELEMETRY_BAD_PACKET) {
+            fprintf(stderr, "bad packet\n");
+            continue;
+        }
+        if(nErr) {
+            perror("Error reading telemetry");
+            return 1;
+        }
+
+        printf("seq=%u up=%u az=%.2f pos=%d dir=%d seek=%d %s%s%s volts=%.2f shutter=%s%s shutter_volts=%.2f clients=%d%s loop_avg=%dus loop_max=%dus loops=%u lost=%u\n",
+               data.nSequence, data.nUptimeMs, data.dAzimuth, data.nPosition, data.nDirection, data.nSeekMode,
+               (data.nFlags & TELEMETRY_FLAG_MOVING) ? "moving" : "stopped",
+               (data.nFlags & TELEMETRY_FLAG_AT_HOME) ? " at_home" : "",
+               (data.nFlags & TELEMETRY_FLAG_RAINING) ? " raining" : "",
+               data.dRotatorVolts,
+               (data.nFlags & TELEMETRY_FLAG_SHUTTER_PRESENT) ? shutterStateName(data.nShutterState) : "absent",
+               (data.nFlags & TELEMETRY_FLAG_SHUTTER_LOW_VOLTS) ? " low_volts" : "",
+               data.dShutterVolts, data.nTcpClients,
+               (data.nFlags & TELEMETRY_FLAG_HAS_CONTROLLER) ? " controlled" : "",
+               data.nLoopAvgUs, data.nLoopMaxUs, data.nLoopCount, data.nLostPackets);
+        fflush(stdout);
+        if(nCount > 0)
+            nCount--;
+    }
+
+    return 0;
+}
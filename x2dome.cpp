@@ -37,6 +37,20 @@ X2Dome::X2Dome(const char* pszSelection, const int& nISIndex,
         m_RTIDome.setHomeOnPark(m_bHomeOnPark);
         m_RTIDome.setHomeOnUnpark(m_bHomeOnUnpark);
         m_RTIDome.enableRainStatusFile(m_bLogRainStatus);
+        m_RTIDome.setTaggedFrames(m_pIniUtil->readInt(PARENT_KEY, CHILD_KEY_TAGGED_FRAMES, true));
+        m_RTIDome.setBinaryFrames(m_pIniUtil->readInt(PARENT_KEY, CHILD_KEY_BINARY_FRAMES, true));
+        m_RTIDome.setGotoTimeCorrection(m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_GOTO_TIME_CORRECTION, 1.0));
+        // in degrees, SlitWidth = 0 sends every goto to the dome
+        m_RTIDome.setSlitWidth(m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_SLIT_WIDTH, 0.0),
+                               m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_SLIT_HYSTERESIS, 1.0));
+        // mount position relative to the dome center, DomeRadius = 0 uses TheSkyX azimuth as is
+        m_RTIDome.setDomeGeometry(m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_LATITUDE, 0.0),
+                                  m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_DOME_RADIUS, 0.0),
+                                  m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_MOUNT_EAST, 0.0),
+                                  m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_MOUNT_NORTH, 0.0),
+                                  m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_MOUNT_UP, 0.0),
+                                  m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_GEM_ARM, 0.0),
+                                  m_pIniUtil->readDouble(PARENT_KEY, CHILD_KEY_FLIP_HA, 0.0));
     }
 }
 
@@ -77,7 +91,7 @@ int X2Dome::establishLink(void)
         m_bLinked = true;
 
     if(m_bLinked)
-        m_RTIDome.getShutterPresent(m_bHasShutterControl);
+        m_bHasShutterControl = m_RTIDome.isShutterPresent(); // Connect already asked
 	return nErr;
 }
 
@@ -85,6 +99,9 @@ int X2Dome::terminateLink(void)
 {
     X2MutexLocker ml(GetMutex());
 
+    // keep what we learned about this dome goto times
+    if (m_pIniUtil)
+        m_pIniUtil->writeDouble(PARENT_KEY, CHILD_KEY_GOTO_TIME_CORRECTION, m_RTIDome.getGotoTimeCorrection());
     m_RTIDome.Disconnect();
 	m_bLinked = false;
 
@@ -212,6 +229,9 @@ int X2Dome::execModalSettingsDialog()
         dx->setPropertyInt("rotationAcceletation","value", nRAcc);
 
         dx->setEnabled("pushButton_3", true);
+        dx->setEnabled("pushButton_6", true);
+        dx->setEnabled("pushButton_7", true);
+        updateGotoStatus(dx);
 
         if(m_bHasShutterControl) {
             dx->setEnabled("shutterSpeed",true);
@@ -350,6 +370,12 @@ int X2Dome::execModalSettingsDialog()
         dx->setEnabled("GatewayIP", false);
         dx->setPropertyString("GatewayIP", "text", "");
         dx->setEnabled("pushButton_5", false);
+        dx->setEnabled("pushButton_6", false);
+        dx->setEnabled("pushButton_7", false);
+        dx->setPropertyString("gotoTimeLeft", "text", "--");
+        dx->setPropertyString("homeTime", "text", "--");
+        dx->setPropertyString("avoidedGotos", "text", "--");
+        dx->setPropertyString("staleReplies", "text", "--");
     }
     dx->setPropertyDouble("homePosition","value", m_RTIDome.getHomeAz());
     dx->setPropertyDouble("parkPosition","value", m_RTIDome.getParkAz());
@@ -380,20 +406,10 @@ int X2Dome::execModalSettingsDialog()
         m_RTIDome.enableRainStatusFile(m_bLogRainStatus);
 
         if(m_bLinked) {
-            m_RTIDome.setDefaultDir(!nReverseDir);
-            m_RTIDome.setHomeAz(dHomeAz);
-            m_RTIDome.setParkAz(dParkAz);
-            m_RTIDome.setNbTicksPerRev(n_nbStepPerRev);
-            m_RTIDome.setRotationSpeed(nRSpeed);
-            m_RTIDome.setRotationAcceleration(nRAcc);
-			m_RTIDome.setBatteryCutOff(batRotCutOff, batShutCutOff);
-            m_RTIDome.setRainAction(nRainAction);
-			if(m_bHasShutterControl) {
-				m_RTIDome.setShutterSpeed(nSSpeed);
-				m_RTIDome.setShutterAcceleration(nSAcc);
-				m_RTIDome.setSutterWatchdogTimerValue(nWatchdog);
+            m_RTIDome.setConfiguration(n_nbStepPerRev, nRAcc, nRSpeed, !nReverseDir, dHomeAz, dParkAz, batRotCutOff, nRainAction,
+                                       nSSpeed, nSAcc, nWatchdog, batShutCutOff);
+			if(m_bHasShutterControl)
 				m_RTIDome.sendShutterHello();
-			}
         }
 
         // save the values to persistent storage
@@ -423,6 +439,8 @@ void X2Dome::uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent)
     int nAcc;
     int n_nbStepPerRev;
     int nWatchdog;
+    int nRainAction;
+    bool bNormal;
     bool bUseDHCP;
     
     if (!strcmp(pszEvent, "on_pushButtonCancel_clicked") && m_bCalibratingDome)
@@ -557,6 +575,11 @@ void X2Dome::uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent)
                 else {
                     uiex->setPropertyString("shutterBatteryLevel","text", "NA");
                 }
+                // the controller stopped hearing from the shutter, its values are stale
+                if(m_RTIDome.isShutterLinkDown())
+                    uiex->setText("shutterPresent", "<html><head/><body><p><span style=\" color:#FF8000;\">Shutter link down</span></p></body></html>");
+                else
+                    uiex->setText("shutterPresent", "<html><head/><body><p><span style=\" color:#00FF00;\">Shutter present</span></p></body></html>");
                 nErr = m_RTIDome.getRainSensorStatus(nRainSensorStatus);
                 if(nErr)
                     uiex->setPropertyString("rainStatus","text", "--");
@@ -566,6 +589,8 @@ void X2Dome::uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent)
                     uiex->setPropertyString("rainStatus","text", sTmpBuf.str().c_str());
                 }
             }
+            if(!m_bCalibratingDome)
+                updateGotoStatus(uiex);
         }
     }
 
@@ -669,6 +694,50 @@ void X2Dome::uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent)
         m_SetNetworkTimer.Reset();
     }
 
+    else if (!strcmp(pszEvent, "on_pushButton_6_clicked")) {
+        // backup the controllers configuration
+        nErr = m_RTIDome.backupConfig();
+        m_RTIDome.getConfigBackupFileName(fName);
+        if(nErr)
+            sErrorMessage << "Error saving the configuration : Error " << nErr;
+        else
+            sErrorMessage << "Configuration saved to " << fName;
+        uiex->messageBox("RTI-Dome Backup", sErrorMessage.str().c_str());
+    }
+
+    else if (!strcmp(pszEvent, "on_pushButton_7_clicked")) {
+        // restore the controllers configuration and show what they now use
+        nErr = m_RTIDome.restoreConfig();
+        if(nErr) {
+            m_RTIDome.getConfigBackupFileName(fName);
+            sErrorMessage << "Error restoring the configuration from " << fName << " : Error " << nErr;
+            uiex->messageBox("RTI-Dome Restore", sErrorMessage.str().c_str());
+        }
+        n_nbStepPerRev = m_RTIDome.getNbTicksPerRev();
+        uiex->setPropertyInt("ticksPerRev","value", n_nbStepPerRev);
+        m_RTIDome.getRotationSpeed(nSpeed);
+        uiex->setPropertyInt("rotationSpeed","value", nSpeed);
+        m_RTIDome.getRotationAcceleration(nAcc);
+        uiex->setPropertyInt("rotationAcceletation","value", nAcc);
+        uiex->setPropertyDouble("homePosition","value", m_RTIDome.getHomeAz());
+        uiex->setPropertyDouble("parkPosition","value", m_RTIDome.getParkAz());
+        m_RTIDome.getDefaultDir(bNormal);
+        uiex->setChecked("needReverse", bNormal?false:true);
+        m_RTIDome.getRainAction(nRainAction);
+        uiex->setCurrentIndex("comboBox", nRainAction);
+        m_RTIDome.getBatteryLevels(dDomeBattery, dDomeCutOff, dShutterBattery, dShutterCutOff);
+        uiex->setPropertyDouble("lowRotBatCutOff","value", dDomeCutOff);
+        if(m_bHasShutterControl) {
+            uiex->setPropertyDouble("lowShutBatCutOff","value", dShutterCutOff);
+            m_RTIDome.getShutterSpeed(nSpeed);
+            uiex->setPropertyInt("shutterSpeed","value", nSpeed);
+            m_RTIDome.getShutterAcceleration(nAcc);
+            uiex->setPropertyInt("shutterAcceleration","value", nAcc);
+            m_RTIDome.getSutterWatchdogTimerValue(nWatchdog);
+            uiex->setPropertyInt("shutterWatchdog", "value", nWatchdog);
+        }
+    }
+
     else if (!strcmp(pszEvent, "on_checkBox_2_stateChanged")) {
         if(uiex->isChecked("checkBox_2")) {
             uiex->setEnabled("IPAddress", false);
@@ -683,6 +752,37 @@ void X2Dome::uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent)
     }
 }
 
+// goto time estimates from the dome motion model and link statistics
+void X2Dome::updateGotoStatus(X2GUIExchangeInterface* uiex)
+{
+    double dSeconds;
+    std::stringstream sTmpBuf;
+
+    m_RTIDome.getGotoTimeLeft(dSeconds);
+    if(dSeconds > 0)
+        sTmpBuf << std::fixed << std::setprecision(1) << dSeconds << " s";
+    else
+        sTmpBuf << "--";
+    uiex->setPropertyString("gotoTimeLeft", "text", sTmpBuf.str().c_str());
+
+    std::stringstream().swap(sTmpBuf);
+    if(!m_RTIDome.getGotoETA(m_RTIDome.getHomeAz(), dSeconds))
+        sTmpBuf << std::fixed << std::setprecision(1) << dSeconds << " s";
+    else
+        sTmpBuf << "--";
+    uiex->setPropertyString("homeTime", "text", sTmpBuf.str().c_str());
+
+    // slaving gotos we didn't send as the dome was already there
+    std::stringstream().swap(sTmpBuf);
+    sTmpBuf << m_RTIDome.getAvoidedGotos();
+    uiex->setPropertyString("avoidedGotos", "text", sTmpBuf.str().c_str());
+
+    // late replies to commands that had timed out, dropped thanks to the sequence ids
+    std::stringstream().swap(sTmpBuf);
+    sTmpBuf << m_RTIDome.getStaleReplies();
+    uiex->setPropertyString("staleReplies", "text", sTmpBuf.str().c_str());
+}
+
 //
 //HardwareInfoInterface
 //
@@ -764,7 +864,7 @@ int X2Dome::dapiGotoAzEl(double dAz, double dEl)
 
 	X2MutexLocker ml(GetMutex());
 
-    nErr = m_RTIDome.gotoAzimuth(dAz);
+    nErr = m_RTIDome.slewToAzimuth(dAz, dEl);
     if(nErr)
         return MAKE_ERR_CODE(PLUGIN_ID, DriverRootInterface::DT_DOME, nErr);
 
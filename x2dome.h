@@ -25,6 +25,18 @@
 #define CHILD_KEY_HOME_ON_PARK      "HomeOnPark"
 #define CHILD_KEY_HOME_ON_UNPARK    "HomeOnUnpark"
 #define CHILD_KEY_LOG_RAIN_STATUS   "LogRainStatus"
+#define CHILD_KEY_GOTO_TIME_CORRECTION  "GotoTimeCorrection"
+#define CHILD_KEY_SLIT_WIDTH        "SlitWidth"
+#define CHILD_KEY_SLIT_HYSTERESIS   "SlitHysteresis"
+#define CHILD_KEY_LATITUDE          "Latitude"
+#define CHILD_KEY_DOME_RADIUS       "DomeRadius"
+#define CHILD_KEY_MOUNT_EAST        "MountOffsetEast"
+#define CHILD_KEY_MOUNT_NORTH       "MountOffsetNorth"
+#define CHILD_KEY_MOUNT_UP          "MountOffsetUp"
+#define CHILD_KEY_GEM_ARM           "GemArm"
+#define CHILD_KEY_FLIP_HA           "FlipHourAngle"
+#define CHILD_KEY_TAGGED_FRAMES     "TaggedFrames"
+#define CHILD_KEY_BINARY_FRAMES     "BinaryFrames"
 
 #if defined(SB_WIN_BUILD)
 #define DEF_PORT_NAME				"COM1"
@@ -144,6 +156,7 @@ private:
 	TickCountInterface								*	m_pTickCount;
 
     void portNameOnToCharPtr(char* pszPort, const int& nMaxSize) const;
+    void updateGotoStatus(X2GUIExchangeInterface* uiex);
 
 
 	int         m_nPrivateISIndex;